@@ -0,0 +1,25 @@
+#ifndef __PICO_JOYSTICK_FREERTOS_CONFIG_H__
+#define __PICO_JOYSTICK_FREERTOS_CONFIG_H__
+
+/* The library's FreeRTOS config plus per task run time stats for the
+ * "threads" command.  The sketches' own include directory is searched before
+ * the library's so this is the config that the kernel and everything else
+ * sees, overriding the library's setting whatever it is.
+ */
+
+#include_next "FreeRTOSConfig.h"
+
+#if PICO_ON_DEVICE && ! defined(__ASSEMBLER__)
+#include "hardware/structs/timer.h"
+
+#undef configGENERATE_RUN_TIME_STATS
+#define configGENERATE_RUN_TIME_STATS 1
+
+// Microseconds from the free running timer, it needs no setup
+#undef portCONFIGURE_TIMER_FOR_RUN_TIME_STATS
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#undef portGET_RUN_TIME_COUNTER_VALUE
+#define portGET_RUN_TIME_COUNTER_VALUE() (timer_hw->timerawl)
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include "pi.h"
+#include "i2c.h"
+#include "hardware/timer.h"
+#include "time-utils.h"
+#include "as5600.h"
+#include "zone-profiler.h"
+
+#define AS5600_ADDR	0x36
+#define STATUS_REG	0x0b
+#define ANGLE_REG	0x0c
+
+#define MUX_ADDR	0x70
+
+#define STATUS_READ_FAILED	0xff
+#define MAGNET_RECHECK_MS	1000
+
+#define I2C_BAUD	(400*1000)
+#define I2C_TIMEOUT_US	1000
+
+bool AS5600::update(uint16_t value) {
+    if (value >= 4096) value = last_value;
+    last_value = value;
+
+    int filtered = filter.filter(value);
+    if (filtered == last_filtered) return false;
+    last_filtered = filtered;
+
+    if (spinner) spinner->set_position(filtered / 4095.0, axis);
+    if (paddle) paddle->set_counts(axis, filtered, 12);
+    return true;
+}
+
+AS5600Bus::AS5600Bus(int bus, int sda, int scl, int active_ms, int idle_ms) : PiThread(bus ? "as5600-bus1" : "as5600-bus0"), i2c(bus ? i2c1 : i2c0), scheduler(bus ? "as5600-bus1" : "as5600-bus0", active_ms, idle_ms) {
+    i2c_init_bus(bus, sda, scl);
+    i2c_set_baudrate(i2c, I2C_BAUD);
+}
+
+void AS5600Bus::add(AS5600 *sensor) {
+    assert(n_sensors < AS5600_MAX_PER_BUS);
+
+    // Every sensor answers at the same address, sharing a bus needs them all on the mux
+    for (int i = 0; i < n_sensors; i++) {
+	assert(sensor->mux_channel != AS5600_NO_MUX && sensors[i]->mux_channel != AS5600_NO_MUX);
+	assert(sensor->mux_channel != sensors[i]->mux_channel);
+    }
+
+    sensors[n_sensors++] = sensor;
+}
+
+bool AS5600Bus::read(AS5600 *sensor, uint8_t reg, uint8_t *buf, int n) {
+    if (sensor->mux_channel != mux_channel) {
+	uint8_t mask = sensor->mux_channel == AS5600_NO_MUX ? 0 : 1 << sensor->mux_channel;
+	if (i2c_write_timeout_us(i2c, MUX_ADDR, &mask, 1, false, I2C_TIMEOUT_US) != 1) return false;
+	mux_channel = sensor->mux_channel;
+    }
+
+    // Repeated start between setting the register and reading it back
+    if (i2c_write_timeout_us(i2c, AS5600_ADDR, &reg, 1, true, I2C_TIMEOUT_US) != 1) return false;
+    return i2c_read_timeout_us(i2c, AS5600_ADDR, buf, n, false, I2C_TIMEOUT_US) == n;
+}
+
+// Reports status changes and returns true if the sensor sees a magnet
+bool AS5600Bus::check_magnet(AS5600 *sensor) {
+    uint8_t status;
+
+    if (! read(sensor, STATUS_REG, &status, 1)) status = STATUS_READ_FAILED;
+
+    if (status != sensor->last_status) {
+	bool md = (status & 0x20) != 0;
+	bool ml = (status & 0x10) != 0;
+	bool mh = (status & 0x08) != 0;
+
+	if (status == STATUS_READ_FAILED) fprintf(stderr, "%s: failed to read the status register\n", sensor->name);
+	else if (md) fprintf(stderr, "%s: magnet detected.\n", sensor->name);
+	else if (mh) fprintf(stderr, "%s: magnet is too close to the sensor\n", sensor->name);
+	else if (ml) fprintf(stderr, "%s: magnet is too far from the sensor\n", sensor->name);
+	else fprintf(stderr, "%s: unexpected status response: 0x%02x.\n", sensor->name, status);
+
+	sensor->last_status = status;
+    }
+
+    return status != STATUS_READ_FAILED && (status & 0x20) != 0;
+}
+
+void AS5600Bus::main(void) {
+    bool all_ok = true;
+    uint32_t last_check_us = time_us_32();
+
+    for (int i = 0; i < n_sensors; i++) {
+	sensors[i]->has_magnet = check_magnet(sensors[i]);
+	if (! sensors[i]->has_magnet) all_ok = false;
+    }
+
+    while (1) {
+	{
+	    PROFILE_ZONE("as5600-pass");
+	    for (int i = 0; i < n_sensors; i++) {
+		uint8_t buf[2];
+
+		// A sensor without a magnet is skipped, the others keep being sampled
+		if (! sensors[i]->has_magnet) continue;
+
+		// A failed read keeps the last value rather than jumping the spinner
+		if (read(sensors[i], ANGLE_REG, buf, 2) && sensors[i]->update(((buf[0] & 0x0f) << 8) | buf[1])) scheduler.activity();
+	    }
+	}
+
+	if (! all_ok && time_us_32() - last_check_us >= MAGNET_RECHECK_MS * 1000) {
+	    all_ok = true;
+	    for (int i = 0; i < n_sensors; i++) {
+		if (! sensors[i]->has_magnet) sensors[i]->has_magnet = check_magnet(sensors[i]);
+		if (! sensors[i]->has_magnet) all_ok = false;
+	    }
+	    last_check_us = time_us_32();
+	}
+
+	scheduler.wait();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef __AS5600_H__
+#define __AS5600_H__
+
+#include <stdint.h>
+#include "hardware/i2c.h"
+#include "filter.h"
+#include "gamepad.h"
+#include "pi-threads.h"
+#include "scan-scheduler.h"
+
+#define AS5600_NO_MUX		-1
+#define AS5600_MAX_PER_BUS	8
+
+/* An AS5600 magnetic angle sensor driving either a spinner axis (relative)
+ * or a paddle axis (absolute).  The sensor only has one address so if a bus
+ * has more than one then every sensor on that bus has to sit behind a
+ * TCA9548A mux.  A sensor that doesn't see its magnet is skipped (and
+ * checked again every second) without holding up the rest of the bus.
+ */
+
+class AS5600 {
+public:
+    AS5600(const char *name, int mux_channel = AS5600_NO_MUX) : name(name), mux_channel(mux_channel), filter(2, 3, name) {
+    }
+
+    void to_spinner(HIDSpinner *spinner, int axis) {
+	this->spinner = spinner;
+	this->axis = axis;
+    }
+
+    void to_paddle(HIDAxes *paddle, int axis) {
+	this->paddle = paddle;
+	this->axis = axis;
+    }
+
+private:
+    friend class AS5600Bus;
+
+    const char *name;
+    int mux_channel;
+    DeadbandFilter filter;
+    HIDSpinner *spinner = NULL;
+    HIDAxes *paddle = NULL;
+    int axis = 0;
+    uint16_t last_value = 0;
+    int last_filtered = -1;
+    bool has_magnet = false;
+    uint8_t last_status = 0;
+
+    bool update(uint16_t value);
+};
+
+/* Samples every sensor on one I2C bus from its own thread, one 2 byte burst
+ * read per sensor per pass.  Each bus gets its own AS5600Bus so sensors on
+ * different buses are sampled in parallel instead of back to back.  Passes
+ * run every active_ms while any sensor is turning and every idle_ms otherwise.
+ */
+
+class AS5600Bus : public PiThread {
+public:
+    AS5600Bus(int bus, int sda, int scl, int active_ms = 2, int idle_ms = 20);
+
+    // Add every sensor before calling start()
+    void add(AS5600 *sensor);
+
+    void main(void) override;
+
+private:
+    i2c_inst_t *i2c;
+    ScanScheduler scheduler;
+    AS5600 *sensors[AS5600_MAX_PER_BUS];
+    int n_sensors = 0;
+    int mux_channel = AS5600_NO_MUX;
+
+    bool read(AS5600 *sensor, uint8_t reg, uint8_t *buf, int n);
+    bool check_magnet(AS5600 *sensor);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "pi.h"
+#include "bluetooth/bluetooth.h"
+#include "gamepad.h"
+#include "pico-joystick.h"
+#include "time-utils.h"
+
+/* Measures report throughput with 1 to N_PLAYERS logical gamepads changing
+ * at once.  Every player's button 1 is toggled as fast as reports go out and
+ * the reports per second (total and per player) are printed for each count.
+ */
+
+#define N_PLAYERS	4
+#define RUN_MS		5000
+
+class BenchGamepad : public Gamepad {
+public:
+    void can_send_now() override {
+	n_reports++;
+	Gamepad::can_send_now();
+    }
+
+    void on_connect() override {
+	Gamepad::on_connect();
+	connected = true;
+    }
+
+    void on_disconnect() override {
+	Gamepad::on_disconnect();
+	connected = false;
+    }
+
+    void wait_connected() {
+	while (! connected) ms_sleep(1000);
+    }
+
+    volatile uint32_t n_reports = 0;
+
+private:
+    bool connected = false;
+};
+
+static void threads_main(int argc, char **argv) {
+    pico_joystick_boot();
+
+    BenchGamepad *gp = new BenchGamepad();
+    HIDButtons *buttons[N_PLAYERS];
+
+    for (int player = 0; player < N_PLAYERS; player++) {
+	HIDCollection *collection = player == 0 ? gp : new HIDCollection(gp, 0x04);
+	buttons[player] = new HIDButtons(collection, 1, 8);
+	collection->add_hid_page(buttons[player]);
+	if (player > 0) gp->add_collection(collection);
+    }
+
+    gp->initialize("Bench Players");
+    bluetooth_start_gamepad("Bench Players");
+
+    while (1) {
+	gp->wait_connected();
+	ms_sleep(1000);
+
+	for (int n_players = 1; n_players <= N_PLAYERS; n_players++) {
+	    struct timespec start;
+	    bool value = false;
+
+	    nano_gettime(&start);
+	    uint32_t start_reports = gp->n_reports;
+
+	    while (nano_elapsed_ms_now(&start) < RUN_MS) {
+		value = ! value;
+		for (int player = 0; player < n_players; player++) buttons[player]->set_button(1, value);
+		ms_sleep(1);
+	    }
+
+	    uint32_t reports = gp->n_reports - start_reports;
+	    printf("%d players: %lu reports/s, %lu reports/s/player\n", n_players,
+		(unsigned long) reports * 1000 / RUN_MS, (unsigned long) reports * 1000 / RUN_MS / n_players);
+	}
+    }
+}
+
+int main(int argc, char **argv) {
+    pi_init_with_threads(threads_main, argc, argv);
+}
@@ -0,0 +1,34 @@
+#include <string.h>
+#include "pi.h"
+#include "mem.h"
+#include "bluetooth-transport.h"
+#include "gamepad.h"
+
+void BluetoothTransport::start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) {
+    this->controller = controller;
+
+    HID::initialize(name, descriptor, descriptor_len, subclass);
+
+    // Every Bluetooth HID input report starts with the DATA | INPUT header
+    report = (uint8_t *) fatal_malloc(1 + max_report_len);
+    report[0] = 0xa1;
+}
+
+void BluetoothTransport::send(const uint8_t *report, int len) {
+    memcpy(&this->report[1], report, len);
+    send_report(this->report, 1 + len);
+}
+
+void BluetoothTransport::can_send_now() {
+    controller->transport_can_send_now(this);
+}
+
+void BluetoothTransport::on_connect() {
+    HID::on_connect();
+    controller->transport_connected(this);
+}
+
+void BluetoothTransport::on_disconnect() {
+    HID::on_disconnect();
+    controller->transport_disconnected(this);
+}
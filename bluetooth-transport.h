@@ -0,0 +1,29 @@
+#ifndef __BLUETOOTH_TRANSPORT_H__
+#define __BLUETOOTH_TRANSPORT_H__
+
+#include "bluetooth/hid.h"
+#include "hid-transport.h"
+
+/* Reports over Bluetooth HID.  The sketch still starts the stack with
+ * bluetooth_start_gamepad() or bluetooth_start() after initialize().
+ */
+
+class BluetoothTransport : public HID, public HIDTransport {
+public:
+    BluetoothTransport(int subclass = 0x580) : subclass(subclass) {
+    }
+
+    void start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) override;
+    void request_send() override { request_can_send_now(); }
+    void send(const uint8_t *report, int len) override;
+
+    void can_send_now() override;
+    void on_connect() override;
+    void on_disconnect() override;
+
+private:
+    int subclass;
+    uint8_t *report = NULL;
+};
+
+#endif
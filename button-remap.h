@@ -0,0 +1,50 @@
+#ifndef __BUTTON_REMAP_H__
+#define __BUTTON_REMAP_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/* Maps a bank-wide read of the gpios (gpio_get_all()) to HIDButtons bits
+ * (bit 0 is the first button id) with one table load per byte of gpios.
+ * The tables are built once at boot or when a profile is activated.
+ */
+
+class ButtonRemap {
+public:
+    ButtonRemap() {
+	clear();
+    }
+
+    void clear() {
+	memset(table, 0, sizeof(table));
+	invert = 0;
+	buttons = 0;
+    }
+
+    void add(int gpio, int bit, bool active_low = true) {
+	if (gpio < 0 || gpio >= 32) return;
+
+	int byte = gpio / 8;
+	uint8_t gpio_bit = 1 << (gpio % 8);
+
+	for (int v = 0; v < 256; v++) {
+	    if (v & gpio_bit) table[byte][v] |= (1u << bit);
+	}
+	if (active_low) invert |= (1u << gpio);
+	buttons |= (1u << bit);
+    }
+
+    uint32_t remap(uint32_t gpios) const {
+	gpios ^= invert;
+	return table[0][gpios & 0xff] | table[1][(gpios >> 8) & 0xff] | table[2][(gpios >> 16) & 0xff] | table[3][gpios >> 24];
+    }
+
+    // The HIDButtons bits that are driven by a gpio
+    uint32_t buttons;
+
+private:
+    uint32_t table[4][256];
+    uint32_t invert;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "pi.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "calibration.h"
+#include "profile-store.h"
+
+#define CALIBRATION_OFFSET	(PROFILE_STORE_OFFSET - FLASH_SECTOR_SIZE)
+
+static_assert(CALIBRATION_OFFSET + FLASH_SECTOR_SIZE <= PROFILE_STORE_OFFSET, "calibration overlaps the profiles");
+
+#define FLASH_TIMEOUT_MS 1000
+
+struct CalibrationRecord {
+    uint32_t magic;
+    int n_axes;
+    AxisRange axes[CALIBRATION_MAX_AXES];
+};
+
+static const CalibrationRecord *stored() {
+    return (const CalibrationRecord *) (XIP_BASE + CALIBRATION_OFFSET);
+}
+
+static void flash_op(void *arg) {
+    const uint8_t *data = (const uint8_t *) arg;
+
+    flash_range_erase(CALIBRATION_OFFSET, FLASH_SECTOR_SIZE);
+    if (data) flash_range_program(CALIBRATION_OFFSET, data, FLASH_PAGE_SIZE);
+}
+
+Calibration::Calibration(int n_axes) : ConsoleCommand("calibration", "[reset | save]"), n_axes(n_axes) {
+    assert(n_axes <= CALIBRATION_MAX_AXES);
+    for (int i = 0; i < n_axes; i++) last_out[i] = (CALIBRATION_FULL_SCALE + 1) / 2;
+
+    const CalibrationRecord *record = stored();
+    if (record->magic == CALIBRATION_MAGIC && record->n_axes == n_axes) {
+	for (int i = 0; i < n_axes; i++) axes[i].load(record->axes[i]);
+    }
+}
+
+void Calibration::save_if_idle(bool idle) {
+    if (reset_requested) {
+	for (int i = 0; i < n_axes; i++) axes[i].reset();
+	flash_safe_execute(flash_op, NULL, FLASH_TIMEOUT_MS);
+	dirty = false;
+	reset_requested = false;
+	return;
+    }
+
+    if (save_requested || (dirty && idle && at_rest())) {
+	save_requested = false;
+	save();
+    }
+}
+
+void Calibration::save() {
+    static_assert(sizeof(CalibrationRecord) <= FLASH_PAGE_SIZE, "calibration record must fit in a flash page");
+    uint8_t page[FLASH_PAGE_SIZE];
+    CalibrationRecord *record = (CalibrationRecord *) page;
+
+    memset(page, 0xff, sizeof(page));
+    record->magic = CALIBRATION_MAGIC;
+    record->n_axes = n_axes;
+    for (int i = 0; i < n_axes; i++) record->axes[i] = axes[i].range;
+
+    // If it fails we'll just try again after the next change
+    flash_safe_execute(flash_op, page, FLASH_TIMEOUT_MS);
+    dirty = false;
+}
+
+void Calibration::process(Writer *w, int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+	reset_requested = true;
+	w->printf("Calibration reset, leave the stick centered\n");
+	return;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "save") == 0) {
+	save_requested = true;
+	return;
+    }
+
+    const CalibrationRecord *record = stored();
+    bool saved = record->magic == CALIBRATION_MAGIC && record->n_axes == n_axes;
+
+    w->printf("%-4s %6s %6s %6s\n", "axis", "min", "center", "max");
+    for (int i = 0; i < n_axes; i++) {
+	const AxisRange &r = axes[i].range;
+	if (axes[i].is_centered()) w->printf("%-4d %6d %6d %6d\n", i, r.min, r.center, r.max);
+	else w->printf("%-4d finding the center\n", i);
+    }
+    w->printf("%s\n", saved ? (dirty ? "changed since it was saved" : "saved") : "not saved");
+}
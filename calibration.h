@@ -0,0 +1,135 @@
+#ifndef __CALIBRATION_H__
+#define __CALIBRATION_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "pico-joystick.h"
+
+#define CALIBRATION_MAGIC	0x4a43414c	// "JCAL"
+#define CALIBRATION_MAX_AXES	4
+#define CALIBRATION_FULL_SCALE	4095
+#define CALIBRATION_MIN_SPAN	512
+#define CALIBRATION_CENTER_SAMPLES	64
+
+/* Rescales one 12-bit analog axis so that its rest position reads 2048 and
+ * the furthest it has been pushed each way reads 0 and 4095.  The center is
+ * averaged over the first samples after boot (or a reset), so the stick must
+ * be left alone then.  The extents start CALIBRATION_MIN_SPAN from the center
+ * and only grow.
+ */
+
+struct AxisRange {
+    uint16_t min, center, max;
+};
+
+class AxisCalibration {
+public:
+    void reset() {
+	n_center = 0;
+	center_total = 0;
+	range.center = 0;
+    }
+
+    void load(AxisRange range) {
+	this->range = range;
+	n_center = CALIBRATION_CENTER_SAMPLES;
+	update_scale();
+    }
+
+    bool is_centered() const { return n_center >= CALIBRATION_CENTER_SAMPLES; }
+
+    // Returns true if the extents grew
+    bool track(int raw) {
+	if (! is_centered()) {
+	    center_total += raw;
+	    if (++n_center == CALIBRATION_CENTER_SAMPLES) {
+		range.center = center_total / CALIBRATION_CENTER_SAMPLES;
+		range.min = range.center > CALIBRATION_MIN_SPAN ? range.center - CALIBRATION_MIN_SPAN : 0;
+		range.max = range.center + CALIBRATION_MIN_SPAN < CALIBRATION_FULL_SCALE ? range.center + CALIBRATION_MIN_SPAN : CALIBRATION_FULL_SCALE;
+		update_scale();
+		return true;
+	    }
+	    return false;
+	}
+
+	if (raw >= range.min && raw <= range.max) return false;
+
+	if (raw < range.min) range.min = raw;
+	else range.max = raw;
+	update_scale();
+	return true;
+    }
+
+    int apply(int raw) const {
+	if (! is_centered()) return MID;
+
+	// The scales are Q16 so this is a multiply and a shift per sample
+	int out;
+	if (raw < range.center) out = MID - (((range.center - raw) * scale_low + (1 << 15)) >> 16);
+	else out = MID + (((raw - range.center) * scale_high + (1 << 15)) >> 16);
+
+	if (out < 0) return 0;
+	if (out > CALIBRATION_FULL_SCALE) return CALIBRATION_FULL_SCALE;
+	return out;
+    }
+
+    AxisRange range = { 0, 0, 0 };
+
+private:
+    static const int MID = (CALIBRATION_FULL_SCALE + 1) / 2;
+
+    int n_center = 0;
+    int center_total = 0;
+    int32_t scale_low = 0;
+    int32_t scale_high = 0;
+
+    void update_scale() {
+	int low = range.center - range.min;
+	int high = range.max - range.center;
+	scale_low = low > 0 ? (MID << 16) / low : 0;
+	scale_high = high > 0 ? ((CALIBRATION_FULL_SCALE - MID) << 16) / high : 0;
+    }
+};
+
+/* The calibration of every analog axis of a sketch, kept in its own flash
+ * sector just below the profiles.  Writing flash stalls both cores (and the
+ * Bluetooth / USB stacks) for tens of ms so new extents are only written on
+ * "calibration save" or once the scan loop's ScanScheduler has gone idle,
+ * never while the stick is being played.  Only the scan thread touches the
+ * axes and flash, the console command just asks it to.
+ */
+
+class Calibration : public ConsoleCommand {
+public:
+    Calibration(int n_axes);
+
+    int apply(int axis, int raw) {
+	if (axes[axis].track(raw)) dirty = true;
+	return last_out[axis] = axes[axis].apply(raw);
+    }
+
+    // Call once per scan from the thread that calls apply(), idle from its ScanScheduler
+    void save_if_idle(bool idle);
+
+    void process(Writer *w, int argc, char **argv) override;
+
+private:
+    int n_axes;
+    AxisCalibration axes[CALIBRATION_MAX_AXES];
+    int last_out[CALIBRATION_MAX_AXES];
+    bool dirty = false;
+    volatile bool reset_requested = false;
+    volatile bool save_requested = false;
+
+    void save();
+
+    // Idle with the stick held over also means no input changes, only save when it's back near the center
+    bool at_rest() {
+	for (int i = 0; i < n_axes; i++) {
+	    if (abs(last_out[i] - (CALIBRATION_FULL_SCALE + 1) / 2) > CALIBRATION_FULL_SCALE / 8) return false;
+	}
+	return true;
+    }
+};
+
+#endif
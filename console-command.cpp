@@ -0,0 +1,42 @@
+#include <string.h>
+#include "pi.h"
+#include "console-command.h"
+
+std::atomic<ConsoleCommand *> ConsoleCommand::commands(NULL);
+
+ConsoleCommand::ConsoleCommand(const char *name, const char *usage) : name(name), usage_str(usage) {
+    next = commands.load(std::memory_order_relaxed);
+    while (! commands.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+bool ConsoleCommand::process_cmd(Writer *w, const char *cmd) {
+    const int max_args = 24;
+    char buf[256];
+    char *argv[max_args];
+    int argc = 0;
+
+    strncpy(buf, cmd, sizeof(buf));
+    buf[sizeof(buf)-1] = '\0';
+
+    char *save;
+    for (char *arg = strtok_r(buf, " \t", &save); arg && argc < max_args; arg = strtok_r(NULL, " \t", &save)) {
+	argv[argc++] = arg;
+    }
+
+    if (argc == 0) return false;
+
+    for (ConsoleCommand *c = commands.load(std::memory_order_acquire); c; c = c->next) {
+	if (strcmp(c->name, argv[0]) == 0) {
+	    c->process(w, argc, argv);
+	    return true;
+	}
+    }
+    return false;
+}
+
+void ConsoleCommand::usage(Writer *w) {
+    for (ConsoleCommand *c = commands.load(std::memory_order_acquire); c; c = c->next) {
+	w->printf("usage: %s %s\n", c->name, c->usage_str);
+    }
+}
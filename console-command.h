@@ -0,0 +1,34 @@
+#ifndef __CONSOLE_COMMAND_H__
+#define __CONSOLE_COMMAND_H__
+
+#include <atomic>
+#include "writer.h"
+
+/* Commands added to the serial and network consoles.  They can be created at
+ * any time from any thread, before or after pico_joystick_boot(), and are
+ * never removed.  A new command is fully linked before it is published with
+ * a compare and swap so a console that is walking the list at the same time
+ * sees either the old or the new list and two commands created at once are
+ * both kept.  The other registries (filters, scan schedulers, thread stats
+ * and profiler zones, which register the first time their code runs on
+ * whichever thread runs it) follow the same rules.
+ */
+
+class ConsoleCommand {
+public:
+    ConsoleCommand(const char *name, const char *usage);
+
+    virtual void process(Writer *w, int argc, char **argv) = 0;
+
+    static bool process_cmd(Writer *w, const char *cmd);
+    static void usage(Writer *w);
+
+private:
+    const char *name;
+    const char *usage_str;
+    ConsoleCommand *next;
+
+    static std::atomic<ConsoleCommand *> commands;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <string.h>
+#include "pi.h"
+#include "lwip/sockets.h"
+#include "threads-console.h"
+#include "time-utils.h"
+#include "console-server.h"
+#include "pico-joystick.h"
+
+/* Sends all of buf, waiting for the socket to drain when its send buffer is
+ * full.  A client that doesn't take any data for CONSOLE_SERVER_SEND_TIMEOUT_MS
+ * is given up on (returns false) so it can't stall the server for long.
+ */
+
+static bool send_all(int fd, const void *buf, size_t n) {
+    const char *p = (const char *) buf;
+
+    while (n > 0) {
+	int sent = lwip_send(fd, p, n, MSG_DONTWAIT);
+
+	if (sent > 0) {
+	    p += sent;
+	    n -= sent;
+	    continue;
+	}
+	if (sent < 0 && errno != EWOULDBLOCK && errno != EAGAIN) return false;
+
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	struct timeval timeout = { CONSOLE_SERVER_SEND_TIMEOUT_MS / 1000, (CONSOLE_SERVER_SEND_TIMEOUT_MS % 1000) * 1000 };
+	if (lwip_select(fd + 1, NULL, &fds, NULL, &timeout) <= 0) return false;
+    }
+
+    return true;
+}
+
+class SocketWriter : public Writer {
+public:
+    int write(const void *buf, size_t n) override {
+	if (failed) return -1;
+	if (! send_all(fd, buf, n)) {
+	    failed = true;
+	    return -1;
+	}
+	return n;
+    }
+
+    int fd = -1;
+    bool failed = false;
+};
+
+class ConsoleClient : public ThreadsConsole {
+public:
+    ConsoleClient(SocketWriter *w) : ThreadsConsole(NULL, w), w(w) {
+    }
+
+    void process_cmd(const char *cmd) override {
+	if (! ConsoleCommand::process_cmd(this, cmd)) ThreadsConsole::process_cmd(cmd);
+    }
+
+    void usage() override {
+	ThreadsConsole::usage();
+	write_str("usage: <button #> <0|1> | threads\n");
+	ConsoleCommand::usage(this);
+    }
+
+    void open(int fd) {
+	w->fd = fd;
+	w->failed = false;
+	len = 0;
+	nano_gettime(&last_activity);
+    }
+
+    void close() {
+	lwip_close(w->fd);
+	w->fd = -1;
+    }
+
+    int fd() { return w->fd; }
+
+    SocketWriter *w;
+    char line[CONSOLE_SERVER_LINE_LEN];
+    int len = 0;
+    struct timespec last_activity;
+};
+
+ConsoleServer::ConsoleServer(uint16_t port) : PiThread("console-server"), port(port), stats("console-server") {
+    for (int i = 0; i < CONSOLE_SERVER_MAX_CLIENTS; i++) {
+	clients[i] = new ConsoleClient(new SocketWriter());
+    }
+    start();
+}
+
+void ConsoleServer::accept_client() {
+    int fd = lwip_accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    for (int i = 0; i < CONSOLE_SERVER_MAX_CLIENTS; i++) {
+	if (clients[i]->fd() < 0) {
+	    clients[i]->open(fd);
+	    return;
+	}
+    }
+
+    const char *msg = "Too many console connections.\n";
+    send_all(fd, msg, strlen(msg));
+    lwip_close(fd);
+}
+
+void ConsoleServer::read_client(ConsoleClient *c) {
+    char buf[64];
+    int n = lwip_recv(c->fd(), buf, sizeof(buf), MSG_DONTWAIT);
+
+    if (n <= 0) {
+	c->close();
+	return;
+    }
+
+    nano_gettime(&c->last_activity);
+
+    for (int i = 0; i < n; i++) {
+	if (buf[i] == '\r') continue;
+	if (buf[i] == '\n') {
+	    c->line[c->len] = '\0';
+	    if (c->len > 0) c->process_cmd(c->line);
+	    c->len = 0;
+
+	    // The client stopped reading our output, don't leave it with a silently truncated reply
+	    if (c->w->failed) {
+		c->close();
+		return;
+	    }
+	} else if (c->len < CONSOLE_SERVER_LINE_LEN - 1) {
+	    c->line[c->len++] = buf[i];
+	}
+    }
+}
+
+void ConsoleServer::main() {
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if ((listen_fd = lwip_socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+	lwip_bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	lwip_listen(listen_fd, 2) < 0) {
+	fprintf(stderr, "Failed to listen on port %d\n", port);
+	return;
+    }
+
+    while (1) {
+	fd_set fds;
+	int max_fd = listen_fd;
+
+	FD_ZERO(&fds);
+	FD_SET(listen_fd, &fds);
+	for (int i = 0; i < CONSOLE_SERVER_MAX_CLIENTS; i++) {
+	    int fd = clients[i]->fd();
+	    if (fd < 0) continue;
+	    FD_SET(fd, &fds);
+	    if (fd > max_fd) max_fd = fd;
+	}
+
+	struct timeval timeout = { 1, 0 };
+	int n_ready = lwip_select(max_fd + 1, &fds, NULL, NULL, &timeout);
+	if (n_ready < 0) {
+	    ms_sleep(100);
+	    continue;
+	}
+	if (n_ready > 0) stats.running();
+
+	if (FD_ISSET(listen_fd, &fds)) accept_client();
+
+	for (int i = 0; i < CONSOLE_SERVER_MAX_CLIENTS; i++) {
+	    ConsoleClient *c = clients[i];
+	    if (c->fd() < 0) continue;
+
+	    if (FD_ISSET(c->fd(), &fds)) read_client(c);
+	    else if (nano_elapsed_ms_now(&c->last_activity) > CONSOLE_SERVER_IDLE_MS) c->close();
+	}
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef __CONSOLE_SERVER_H__
+#define __CONSOLE_SERVER_H__
+
+#include <time.h>
+#include "pi-threads.h"
+#include "thread-stats.h"
+
+/* One thread serves every network console connection.  Each connection has a
+ * fixed line buffer, the number of connections is capped and idle ones are
+ * closed so memory use doesn't grow with reconnecting clients.  Output waits
+ * for a slow client (up to a timeout) rather than being dropped.
+ */
+
+#define CONSOLE_SERVER_MAX_CLIENTS	4
+#define CONSOLE_SERVER_LINE_LEN		256
+#define CONSOLE_SERVER_IDLE_MS		(5*60*1000)
+#define CONSOLE_SERVER_SEND_TIMEOUT_MS	2000
+
+class ConsoleClient;
+
+class ConsoleServer : public PiThread {
+public:
+    ConsoleServer(uint16_t port);
+
+    void main(void) override;
+
+private:
+    uint16_t port;
+    int listen_fd = -1;
+    ConsoleClient *clients[CONSOLE_SERVER_MAX_CLIENTS];
+    ThreadStats stats;
+
+    void accept_client();
+    void read_client(ConsoleClient *c);
+};
+
+#endif
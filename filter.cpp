@@ -0,0 +1,38 @@
+#include <string.h>
+#include "pi.h"
+#include "filter.h"
+#include "pico-joystick.h"
+
+std::atomic<Filter *> Filter::filters(NULL);
+
+Filter::Filter(const char *name) : name(name) {
+    if (name) {
+	next = filters.load(std::memory_order_relaxed);
+	while (! filters.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+    }
+}
+
+class FiltersCommand : public ConsoleCommand {
+public:
+    FiltersCommand() : ConsoleCommand("filters", "[reset]") {
+    }
+
+    void process(Writer *w, int argc, char **argv) override {
+	bool reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+
+	if (! reset) w->printf("%-16s %10s %10s %8s %8s\n", "filter", "samples", "changes", "avg-lag", "max-lag");
+
+	for (Filter *f = Filter::get_filters(); f; f = f->get_next()) {
+	    if (reset) {
+		f->reset_stats();
+		continue;
+	    }
+	    uint32_t avg_lag_x100 = f->n_samples ? f->total_lag * 100 / f->n_samples : 0;
+	    w->printf("%-16s %10lu %10lu %5lu.%02lu %8d\n", f->name, (unsigned long) f->n_samples, (unsigned long) f->n_changes,
+		(unsigned long) avg_lag_x100 / 100, (unsigned long) avg_lag_x100 % 100, f->max_lag);
+	}
+    }
+};
+
+static FiltersCommand filters_command;
@@ -0,0 +1,171 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Integer filters for analog and angle inputs.  Each channel gets its own
+ * filter object.  Named filters keep statistics of how many output changes
+ * they let through (jitter) and how far the output trails the input (lag)
+ * which are shown and reset by the "filters" console command.
+ */
+
+class Filter {
+public:
+    Filter(const char *name = NULL);
+
+    int filter(int value) {
+	int out = apply(value);
+
+	n_samples++;
+	if (out != last_out) n_changes++;
+	int lag = abs(value - out);
+	total_lag += lag;
+	if (lag > max_lag) max_lag = lag;
+	last_out = out;
+
+	return out;
+    }
+
+    virtual void reset() { }
+
+    void reset_stats() {
+	n_samples = n_changes = 0;
+	total_lag = 0;
+	max_lag = 0;
+    }
+
+    static Filter *get_filters() { return filters.load(std::memory_order_acquire); }
+    Filter *get_next() { return next; }
+
+    const char *name;
+    uint32_t n_samples = 0;
+    uint32_t n_changes = 0;
+    uint64_t total_lag = 0;
+    int max_lag = 0;
+
+protected:
+    virtual int apply(int value) = 0;
+
+private:
+    int last_out = 0;
+    Filter *next = NULL;
+
+    static std::atomic<Filter *> filters;
+};
+
+/* Ignores changes of up to +/- band counts but still follows slow motion:
+ * the offset of the input from the held value is averaged over roughly
+ * 2^drift_shift samples and once that average exceeds half the band the
+ * input is followed.  Noise averages out to nothing and doesn't.
+ */
+
+class DeadbandFilter : public Filter {
+public:
+    DeadbandFilter(int band, int drift_shift = 3, const char *name = NULL) : Filter(name), band(band), drift_shift(drift_shift), drift_limit((band << drift_shift) / 2) {
+    }
+
+    void reset() override {
+	held = drift = 0;
+    }
+
+protected:
+    int apply(int value) override {
+	int delta = value - held;
+
+	drift += delta - (drift >> drift_shift);
+	if (delta > band || delta < -band || drift > drift_limit || drift < -drift_limit) {
+	    held = value;
+	    drift = 0;
+	}
+	return held;
+    }
+
+private:
+    int band;
+    int drift_shift;
+    int drift_limit;
+    int held = 0;
+    int drift = 0;
+};
+
+/* Median of the last N samples, rejects single sample spikes. */
+
+template<int N>
+class MedianFilter : public Filter {
+public:
+    MedianFilter(const char *name = NULL) : Filter(name) {
+	static_assert(N % 2 == 1, "median filters need an odd number of samples");
+    }
+
+    void reset() override {
+	n = pos = 0;
+    }
+
+protected:
+    int apply(int value) override {
+	samples[pos] = value;
+	pos = (pos + 1) % N;
+	if (n < N) n++;
+
+	int sorted[N];
+	for (int i = 0; i < n; i++) {
+	    int j = i;
+	    for (; j > 0 && sorted[j-1] > samples[i]; j--) sorted[j] = sorted[j-1];
+	    sorted[j] = samples[i];
+	}
+	return sorted[n / 2];
+    }
+
+private:
+    int samples[N];
+    int n = 0;
+    int pos = 0;
+};
+
+/* Velocity adaptive exponential smoothing in the spirit of the 1-euro filter.
+ * At rest the output moves min_alpha/256 of the way to the input each sample
+ * which hides ADC noise.  As the (smoothed) speed grows the smoothing factor
+ * grows by beta/256 per count of speed until the output simply tracks the
+ * input, so fast movement sees no added lag.
+ */
+
+class AdaptiveFilter : public Filter {
+public:
+    AdaptiveFilter(int min_alpha = 32, int beta = 16, const char *name = NULL) : Filter(name), min_alpha(min_alpha), beta(beta) {
+    }
+
+    void reset() override {
+	primed = false;
+    }
+
+protected:
+    int apply(int value) override {
+	int value_q8 = value << 8;
+
+	if (! primed) {
+	    out_q8 = value_q8;
+	    speed_q8 = 0;
+	    primed = true;
+	}
+
+	int delta_q8 = value_q8 - out_q8;
+	speed_q8 += (abs(delta_q8) - speed_q8) >> 2;
+
+	int alpha = min_alpha + (speed_q8 >> 8) * beta;
+	if (alpha > 256) alpha = 256;
+
+	out_q8 += (delta_q8 * alpha) >> 8;
+	return (out_q8 + 128) >> 8;
+    }
+
+private:
+    int min_alpha;
+    int beta;
+    bool primed = false;
+    int out_q8 = 0;
+    int speed_q8 = 0;
+};
+
+#endif
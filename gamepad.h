@@ -4,36 +4,81 @@
 #include "pi.h"
 #include "mem.h"
 #include "writer.h"
-#include "bluetooth/hid.h"
 #include "memory.h"
 #include "pi-threads.h"
+#include "hid-transport.h"
+#include "trace.h"
+#include "zone-profiler.h"
+#include <atomic>
 #include <list>
 
+#if PICO_ON_DEVICE
+#include "bluetooth-transport.h"
+#if USB_HID
+#include "usb-transport.h"
+#endif
+#endif
+
+class HIDCollection;
+
+/* Packs report fields at bit granularity, least significant bit first as
+ * HID expects.  The report must be zeroed before writing.
+ */
+
+class HIDReportWriter {
+public:
+    HIDReportWriter(uint8_t *report) : report(report) {
+    }
+
+    void put(uint32_t value, int bits) {
+	if ((pos % 8) == 0 && (bits % 8) == 0) {
+	    for (; bits > 0; bits -= 8, pos += 8, value >>= 8) report[pos / 8] = value;
+	    return;
+	}
+
+	while (bits > 0) {
+	    int shift = pos % 8;
+	    int n = 8 - shift < bits ? 8 - shift : bits;
+	    report[pos / 8] |= (value & ((1 << n) - 1)) << shift;
+	    value >>= n;
+	    bits -= n;
+	    pos += n;
+	}
+    }
+
+    int pos = 0;
+
+private:
+    uint8_t *report;
+};
+
 class HIDPage {
 public:
     virtual int add_descriptor(uint8_t *descriptor) = 0;
-    virtual int get_report_size() = 0;
-    virtual void fill_report(uint8_t *report) = 0;
+    virtual int get_report_bits() = 0;
+    virtual void fill_report(HIDReportWriter *report) = 0;
+
+protected:
+    static void request_can_send_now(HIDCollection *collection);
 };
 
 class HIDButtons : public HIDPage {
 public:
-    HIDButtons(HID *hid, int first_button_id = 0, int last_button_id = 31) : hid(hid) {
+    HIDButtons(HIDCollection *collection, int first_button_id = 0, int last_button_id = 31) : collection(collection) {
 	n_buttons = (last_button_id - first_button_id + 1);
-	n_buttons = (n_buttons + 7) / 8 * 8;
-
-	state_bytes = n_buttons / 8;
-	state = (uint8_t *) fatal_malloc(state_bytes);
-	memset(state, 0, state_bytes);
+	state_words = (n_buttons + 31) / 32;
+	state = (uint32_t *) fatal_malloc(state_words * sizeof(*state));
+	memset(state, 0, state_words * sizeof(*state));
 
 	button_range[0] = first_button_id;
 	button_range[1] = last_button_id;
 
-	transaction_state = (uint8_t *) fatal_malloc(state_bytes);
+	transaction_state = (uint32_t *) fatal_malloc(state_words * sizeof(*state));
    }
 
    ~HIDButtons() {
 	fatal_free(state);
+	fatal_free(transaction_state);
    }
 
    int add_descriptor(uint8_t *descriptor) override {
@@ -58,115 +103,252 @@ public:
 	return i;
     }
 
-    int get_report_size() override {
-	return state_bytes;
+    int get_report_bits() override {
+	return n_buttons;
     }
 
-    void fill_report(uint8_t *buf) override {
-	memcpy(buf, state, state_bytes);
+    void fill_report(HIDReportWriter *report) override {
+	PROFILE_ZONE("fill-buttons");
+	for (int word = 0, bits = n_buttons; bits > 0; word++, bits -= 32) {
+	    report->put(state[word], bits < 32 ? bits : 32);
+	}
     }
 
     void set_button(int id, bool value) {
 	//assert(id >= button_range[0] && id <= button_range[1]);
 	id -= button_range[0];
 
-	int byte = id/8;
-	int bit = id%8;
+	uint32_t bit = 1u << (id % 32);
+	set_buttons(value ? bit : 0, bit, id / 32);
+    }
+
+    /* Set every button whose bit is set in mask to the matching bit of
+     * values.  Bit 0 of word 0 is first_button_id.
+     */
 
-	uint8_t *this_state;
+    void set_buttons(uint32_t values, uint32_t mask, int word = 0) {
+	uint32_t *this_state;
 	if (n_transactions) this_state = transaction_state;
 	else this_state = state;
 
-	uint8_t old_state = this_state[byte];
-	if (value) this_state[byte] |= (1 << bit);
-	else this_state[byte] &= ~(1 << bit);
+	uint32_t old_state = this_state[word];
+	this_state[word] = (old_state & ~mask) | (values & mask);
 
-	if (! n_transactions && old_state != this_state[byte]) {
-	    hid->request_can_send_now();
+	if (old_state != this_state[word]) {
+	    TRACE(TRACE_BUTTONS_CHANGED, word);
+	    if (! n_transactions) request_can_send_now(collection);
 	}
     }
 
     void begin_transaction() {
+	TRACE(TRACE_TRANSACTION_BEGIN, n_transactions);
 	if (n_transactions++ == 0) {
-	    memcpy(transaction_state, state, state_bytes);
+	    memcpy(transaction_state, state, state_words * sizeof(*state));
 	}
     }
 
     void end_transaction() {
-	if (--n_transactions == 0 && memcmp(state, transaction_state, state_bytes) != 0) {
-	    memcpy(state, transaction_state, state_bytes);
-	    hid->request_can_send_now();
+	if (--n_transactions == 0 && memcmp(state, transaction_state, state_words * sizeof(*state)) != 0) {
+	    memcpy(state, transaction_state, state_words * sizeof(*state));
+	    request_can_send_now(collection);
 	}
+	TRACE(TRACE_TRANSACTION_END, n_transactions);
     }
 
 private:
-    HID *hid;
-    int state_bytes;
-    uint8_t *state;
+    HIDCollection *collection;
+    int state_words;
+    uint32_t *state;
     int n_buttons;
     int button_range[2];
 
     int n_transactions = 0;
-    uint8_t *transaction_state;
+    uint32_t *transaction_state;
 };
 
-class HIDXY : public HIDPage {
-public:
-    HIDXY(HID *hid) : hid(hid) {
-   }
+/* n_axes absolute axes of the given usages, each bits wide.  Signed axes
+ * report -(2^(bits-1)-1) .. 2^(bits-1)-1 and unsigned ones (triggers) report
+ * 0 .. 2^bits-1.
+ */
 
+class HIDAxes : public HIDPage {
+public:
+    HIDAxes(HIDCollection *collection, int n_axes, const uint8_t *usages, int bits = 8, bool is_signed = true) : collection(collection), n_axes(n_axes), bits(bits), is_signed(is_signed) {
+	assert(n_axes <= max_axes);
+	assert(bits <= 16);
+	memcpy(this->usages, usages, n_axes);
+	memset(values, 0, sizeof(values));
+
+	if (is_signed) {
+	    max = (1 << (bits - 1)) - 1;
+	    min = -max;
+	} else {
+	    max = (1 << bits) - 1;
+	    min = 0;
+	}
+    }
 
-   int add_descriptor(uint8_t *descriptor) override {
+    int add_descriptor(uint8_t *descriptor) override {
 	int i = 0;
 	descriptor[i++] = 0x05;
 	descriptor[i++] = 0x01;	// USAGE_PAGE (Generic Desktop Controls)
-	descriptor[i++] = 0x09;
-	descriptor[i++] = 0x30; // USAGE (X)
-	descriptor[i++] = 0x09;
-	descriptor[i++] = 0x31; // USAGE (Y)
-	descriptor[i++] = 0x15;
-	descriptor[i++] = -127;    // LOGICAL_MINIMUM
-	descriptor[i++] = 0x25;
-	descriptor[i++] = 127;  // LOGICAL_MAXIMUM
+	for (int axis = 0; axis < n_axes; axis++) {
+	    descriptor[i++] = 0x09;
+	    descriptor[i++] = usages[axis]; // USAGE (X, Y, Z, Rx, ...)
+	}
+	descriptor[i++] = 0x16;
+	descriptor[i++] = min & 0xff;	// LOGICAL_MINIMUM
+	descriptor[i++] = (min >> 8) & 0xff;
+	descriptor[i++] = 0x27;
+	descriptor[i++] = max & 0xff;	// LOGICAL_MAXIMUM
+	descriptor[i++] = (max >> 8) & 0xff;
+	descriptor[i++] = 0;
+	descriptor[i++] = 0;
 	descriptor[i++] = 0x95;
-	descriptor[i++] = 2;    // REPORT_COUNT
+	descriptor[i++] = n_axes;	// REPORT_COUNT
 	descriptor[i++] = 0x75;
-	descriptor[i++] = 8;    // REPORT_SIZE
+	descriptor[i++] = bits;	// REPORT_SIZE
 	descriptor[i++] = 0x81;
 	descriptor[i++] = 0x02; // INPUT (Data,Var,Abs)
 
 	return i;
     }
 
-    int get_report_size() override {
-	return 2;
+    int get_report_bits() override {
+	return n_axes * bits;
+    }
+
+    void fill_report(HIDReportWriter *report) override {
+	PROFILE_ZONE("fill-axes");
+	for (int axis = 0; axis < n_axes; axis++) report->put(values[axis], bits);
     }
 
-    void fill_report(uint8_t *buf) override {
-	buf[0] = x;
-	buf[1] = y;
+    void set(int axis, int value) {
+	if (value < min) value = min;
+	if (value > max) value = max;
+
+	if (value != values[axis]) {
+	    values[axis] = value;
+	    request_can_send_now(collection);
+	}
+    }
+
+    // Sets an axis from a raw 0 .. 2^count_bits-1 reading (eg ADC counts) without losing resolution
+    void set_counts(int axis, uint32_t counts, int count_bits) {
+	set(axis, (int) (counts * (uint32_t) (max - min) / ((1u << count_bits) - 1)) + min);
+    }
+
+    void set_pct(int axis, double pct) {
+	set(axis, pct * (max - min) + min);
+    }
+
+protected:
+    HIDCollection *collection;
+    static const int max_axes = 8;
+    int n_axes;
+    int bits;
+    bool is_signed;
+    int min, max;
+    uint8_t usages[max_axes];
+    int values[max_axes];
+};
+
+class HIDXY : public HIDAxes {
+public:
+    HIDXY(HIDCollection *collection, int bits = 8) : HIDAxes(collection, 2, xy_usages(), bits) {
     }
 
     void move(double x_pct, double y_pct) {
-	int8_t x = (x_pct * 254 - 127);
-	int8_t y = (y_pct * 254 - 127);
+	set_pct(0, x_pct);
+	set_pct(1, y_pct);
+    }
 
-	if (x != this->x || y != this->y) {
-	    this->x = x;
-	    this->y = y;
-	    hid->request_can_send_now();
-	} 
+    void move_counts(uint32_t x, uint32_t y, int count_bits = 12) {
+	set_counts(0, x, count_bits);
+	set_counts(1, y, count_bits);
     }
 
 private:
-    HID *hid;
-    int8_t x = 0;
-    int8_t y = 0;
+    static const uint8_t *xy_usages() {
+	static const uint8_t usages[2] = { 0x30, 0x31 };	// X, Y
+	return usages;
+    }
+};
+
+/* A 4-bit hat switch.  set() takes the UP/DOWN/LEFT/RIGHT bits used by the
+ * thumbstick maps (bit 0 up, 1 down, 2 left, 3 right).
+ */
+
+class HIDHat : public HIDPage {
+public:
+    HIDHat(HIDCollection *collection) : collection(collection) {
+    }
+
+    int add_descriptor(uint8_t *descriptor) override {
+	int i = 0;
+	descriptor[i++] = 0x05;
+	descriptor[i++] = 0x01;	// USAGE_PAGE (Generic Desktop Controls)
+	descriptor[i++] = 0x09;
+	descriptor[i++] = 0x39;	// USAGE (Hat switch)
+	descriptor[i++] = 0x15;
+	descriptor[i++] = 0;	// LOGICAL_MINIMUM
+	descriptor[i++] = 0x25;
+	descriptor[i++] = 7;	// LOGICAL_MAXIMUM
+	descriptor[i++] = 0x35;
+	descriptor[i++] = 0;	// PHYSICAL_MINIMUM
+	descriptor[i++] = 0x46;
+	descriptor[i++] = 315 & 0xff;	// PHYSICAL_MAXIMUM
+	descriptor[i++] = 315 >> 8;
+	descriptor[i++] = 0x65;
+	descriptor[i++] = 0x14;	// UNIT (Eng Rot:Angular Pos)
+	descriptor[i++] = 0x75;
+	descriptor[i++] = 4;	// REPORT_SIZE
+	descriptor[i++] = 0x95;
+	descriptor[i++] = 1;	// REPORT_COUNT
+	descriptor[i++] = 0x81;
+	descriptor[i++] = 0x42;	// INPUT (Data,Var,Abs,Null)
+	descriptor[i++] = 0x35;
+	descriptor[i++] = 0;	// PHYSICAL_MINIMUM
+	descriptor[i++] = 0x45;
+	descriptor[i++] = 0;	// PHYSICAL_MAXIMUM
+	descriptor[i++] = 0x65;
+	descriptor[i++] = 0x00;	// UNIT (None)
+
+	return i;
+    }
+
+    int get_report_bits() override {
+	return 4;
+    }
+
+    void fill_report(HIDReportWriter *report) override {
+	report->put(value, 4);
+    }
+
+    void set(uint8_t directions) {
+	// 0 is north going clockwise to 7 (north west), 8 is centered
+	static const uint8_t hat[16] = {
+	    8, 0, 4, 8,		// none, U, D, UD
+	    6, 7, 5, 6,		// L, UL, DL, UDL
+	    2, 1, 3, 2,		// R, UR, DR, UDR
+	    8, 0, 4, 8,		// LR, ULR, DLR, UDLR
+	};
+	uint8_t value = hat[directions & 0xf];
+
+	if (value != this->value) {
+	    this->value = value;
+	    request_can_send_now(collection);
+	}
+    }
+
+private:
+    HIDCollection *collection;
+    uint8_t value = 8;	// centered (null)
 };
 
 class HIDSpinner : public HIDPage {
 public:
-    HIDSpinner(HID *hid) : hid(hid) {
+    HIDSpinner(HIDCollection *collection) : collection(collection) {
 	lock = new PiMutex();
     }
 
@@ -178,7 +360,7 @@ public:
 	descriptor[i++] = 0x09;
 	descriptor[i++] = 0x30; 	// USAGE (X)
 	descriptor[i++] = 0x09;
-	descriptor[i++] = 0x31; 	// USAGE (X)
+	descriptor[i++] = 0x31; 	// USAGE (Y)
 	descriptor[i++] = 0x16;
 	descriptor[i++] = -2000 & 0xff;	// LOGICAL_MINIMUM
 	descriptor[i++] = -2000 >> 8;	// LOGICAL_MINIMUM
@@ -195,103 +377,328 @@ public:
 	return i;
     }
 
-    int get_report_size() override {
-	return 4;
+    int get_report_bits() override {
+	return 32;
     }
 
-    void fill_report(uint8_t *buf) override {
+    void fill_report(HIDReportWriter *report) override {
+	PROFILE_ZONE("fill-spinner");
 	lock->lock();
-	int report_ticks = ticks();
-	delta = 0;
+	int report_x = ticks(0);
+	int report_y = ticks(1);
+	delta[0] = delta[1] = 0;
 	lock->unlock();
 
-	buf[0] = report_ticks & 0xff;
-	buf[1] = report_ticks >> 8;
-	buf[2] = buf[3];
+	report->put(report_x, 16);
+	report->put(report_y, 16);
     }
 
-    void set_position(double position) {
+    // axis 0 is X (the first spinner) and axis 1 is Y (a second spinner)
+    void set_position(double position, int axis = 0) {
 	lock->lock();
 
-	double delta = position - this->position;
+	double delta = position - this->position[axis];
+
+	if (delta > 0.5) delta = position - (1 + this->position[axis]);
+	if (delta < -0.5) delta = (1 + position) - this->position[axis];
+
+	this->delta[axis] += delta;
+	this->position[axis] = position;
+
+	int report_ticks = ticks(axis);
 
-	if (delta > 0.5) delta = position - (1 + this->position);
-	if (delta < -0.5) delta = (1 + position) - this->position;
+	lock->unlock();
 
-	this->delta += delta;
-	this->position = position;
+	if (report_ticks != 0) request_can_send_now(collection);
+    }
 
-	int report_ticks = ticks();
+    // Relative motion from an encoder that has counts_per_rev counts per revolution
+    void add_counts(int counts, int counts_per_rev, int axis = 0) {
+	if (counts == 0) return;
 
+	lock->lock();
+	delta[axis] += (double) counts / counts_per_rev;
+	int report_ticks = ticks(axis);
 	lock->unlock();
 
-	if (report_ticks != 0) hid->request_can_send_now();
+	if (report_ticks != 0) request_can_send_now(collection);
     }
 
 private:
-    HID *hid;
+    HIDCollection *collection;
     PiMutex *lock;
-    double position = 0;
-    double delta = 0;
+    double position[2] = { 0, 0 };
+    double delta[2] = { 0, 0 };
 
-    int ticks() { return delta * 2000; }
+    int ticks(int axis) { return delta[axis] * 2000; }
 };
 
-class HIDController : public HID {
+class HIDController;
+
+/* An application collection: one logical device with its own pages.  The
+ * controller is its own first collection and extra collections (player 2,
+ * ...) each get a report id and are only sent when their state changes.
+ */
+
+class HIDCollection {
 public:
-    HIDController(uint8_t usage) : usage(usage) {
+    HIDCollection(HIDController *controller, uint8_t usage) : controller(controller), usage(usage) {
     }
 
     void add_hid_page(HIDPage *page) {
 	hid_pages.push_back(page);
     }
 
-    void initialize(const char *name) {
-	int descriptor_len = 0;
-	descriptor[descriptor_len++] = 0x05;
-	descriptor[descriptor_len++] = 0x01; // USAGE_PAGE (Generic Desktop)
-	descriptor[descriptor_len++] = 0x09;
-	descriptor[descriptor_len++] = usage; // USAGE (___)
-	descriptor[descriptor_len++] = 0xa1;
-	descriptor[descriptor_len++] = 0x01; // COLLECTION (Application)
-	descriptor[descriptor_len++] = 0xa1;
-	descriptor[descriptor_len++] = 0x00; // COLLECTION (Physical)
-
-	report_size = 1;
+    int add_descriptor(uint8_t *descriptor, uint8_t report_id) {
+	int i = 0;
+	descriptor[i++] = 0x05;
+	descriptor[i++] = 0x01; // USAGE_PAGE (Generic Desktop)
+	descriptor[i++] = 0x09;
+	descriptor[i++] = usage; // USAGE (___)
+	descriptor[i++] = 0xa1;
+	descriptor[i++] = 0x01; // COLLECTION (Application)
+	if (report_id) {
+	    descriptor[i++] = 0x85;
+	    descriptor[i++] = report_id; // REPORT_ID
+	}
+	descriptor[i++] = 0xa1;
+	descriptor[i++] = 0x00; // COLLECTION (Physical)
+
+	this->report_id = report_id;
+	int report_bits = report_id ? 8 : 0;
 	for(auto page : hid_pages) {
-	    descriptor_len += page->add_descriptor(&descriptor[descriptor_len]);
-	    report_size += page->get_report_size();
+	    i += page->add_descriptor(&descriptor[i]);
+	    report_bits += page->get_report_bits();
+	}
+
+	if (report_bits % 8) {
+	    descriptor[i++] = 0x75;
+	    descriptor[i++] = 8 - report_bits % 8;	// REPORT_SIZE
+	    descriptor[i++] = 0x95;
+	    descriptor[i++] = 1;	// REPORT_COUNT
+	    descriptor[i++] = 0x81;
+	    descriptor[i++] = 0x03;	// INPUT (Cnst,Var,Abs) padding
 	}
+	report_size = (report_bits + 7) / 8;
+
+	descriptor[i++] = 0xc0;                    // END_COLLECTION
+	descriptor[i++] = 0xc0;                    // END_COLLECTION
+
+	return i;
+    }
+
+    int get_report_size() {
+	return report_size;
+    }
+
+    void fill_report(uint8_t *report) {
+	HIDReportWriter writer(report);
 
-	descriptor[descriptor_len++] = 0xc0;                    // END_COLLECTION
-	descriptor[descriptor_len++] = 0xc0;                    // END_COLLECTION
+	memset(report, 0, report_size);
+	if (report_id) writer.put(report_id, 8);
+	for (auto page : hid_pages) page->fill_report(&writer);
+    }
 
-	HID::initialize(name, descriptor, descriptor_len, subclass);
+    void changed();
+
+    volatile bool dirty = false;
+
+private:
+    HIDController *controller;
+    uint8_t usage;
+    uint8_t report_id = 0;
+    int report_size = 0;
+    std::list<HIDPage *> hid_pages;
+};
+
+/* The device: its own first collection plus any extra collections, sent over
+ * one or more transports.  Sketches override can_send_now(), on_connect()
+ * and on_disconnect() to hook in.  Connected means any transport has a host.
+ */
+
+class HIDController : public HIDCollection {
+public:
+    HIDController(uint8_t usage) : HIDCollection(this, usage) {
+	collections[n_collections++] = this;
+	lock = new PiMutex();
+    }
+
+    virtual ~HIDController() {}
+
+    void add_collection(HIDCollection *collection) {
+	assert(n_collections < max_collections);
+	collections[n_collections++] = collection;
+    }
+
+    // Earlier transports are preferred when several have a host connected
+    void add_transport(HIDTransport *transport) {
+	assert(n_transports < max_transports);
+	transports[n_transports++] = transport;
+    }
+
+    // Without any explicit transports this uses Bluetooth (and USB when built with USB_HID)
+    void initialize(const char *name) {
+	int descriptor_len = 0;
+	int report_id = n_collections > 1 ? 1 : 0;
+
+	report_size = 0;
+	for (int i = 0; i < n_collections; i++) {
+	    descriptor_len += collections[i]->add_descriptor(&descriptor[descriptor_len], report_id);
+	    if (report_id) report_id++;
+	    if (collections[i]->get_report_size() > report_size) report_size = collections[i]->get_report_size();
+	}
 
 	report = (uint8_t *) fatal_malloc(sizeof(*report) * report_size);
-	report[0] = 0xa1;
+
+#if PICO_ON_DEVICE
+	if (n_transports == 0) {
+#if USB_HID
+	    add_transport(new UsbTransport());
+#endif
+	    add_transport(new BluetoothTransport(subclass));
+	}
+#endif
+	assert(n_transports > 0);
+
+	for (int i = 0; i < n_transports; i++) transports[i]->start(this, name, descriptor, descriptor_len, report_size);
     }
 
-    void can_send_now() override {
-	int pos = 1;
-	for (auto page : hid_pages) {
-	    page->fill_report(&report[pos]);
-	    pos += page->get_report_size();
+    void request_can_send_now() {
+	HIDTransport *transport = active_transport();
+	if (transport) transport->request_send();
+    }
+
+    // Only valid inside can_send_now()
+    void send_report(const uint8_t *report, int len) {
+	sending->send(report, len);
+    }
+
+    virtual void can_send_now() {
+	PROFILE_ZONE("can-send-now");
+	TRACE(TRACE_CAN_SEND_NOW_BEGIN, 0);
+
+	HIDCollection *collection = next_dirty_collection();
+	collection->fill_report(report);
+
+	{
+	    PROFILE_ZONE("send-report");
+	    TRACE(TRACE_SEND_REPORT, collection->get_report_size());
+	    send_report(report, collection->get_report_size());
 	}
-	send_report(report, report_size);
+
+	for (int i = 0; i < n_collections; i++) {
+	    if (collections[i]->dirty) {
+		request_can_send_now();
+		break;
+	    }
+	}
+	TRACE(TRACE_CAN_SEND_NOW_END, 0);
+    }
+
+    virtual void on_connect() {
+	TRACE(TRACE_CONNECT, 0);
+    }
+
+    virtual void on_disconnect() {
+	TRACE(TRACE_DISCONNECT, 0);
+    }
+
+    bool is_connected() { return connected.load() != 0; }
+
+    /* Called by the transports. */
+
+    void transport_can_send_now(HIDTransport *transport) {
+	// Another transport may have taken over since this one asked
+	if (transport != active_transport()) return;
+
+	lock->lock();
+	sending = transport;
+	can_send_now();
+	sending = NULL;
+	lock->unlock();
+    }
+
+    void transport_connected(HIDTransport *transport) {
+	// The BTstack context and the USB thread can both get here at once
+	uint8_t was_connected = connected.fetch_or(transport_bit(transport));
+	if (! was_connected) on_connect();
+
+	// The active transport may have changed, give its host the full state
+	for (int i = 0; i < n_collections; i++) collections[i]->dirty = true;
+	request_can_send_now();
+    }
+
+    void transport_disconnected(HIDTransport *transport) {
+	uint8_t bit = transport_bit(transport);
+
+	if ((connected.fetch_and(~bit) & ~bit) == 0) {
+	    on_disconnect();
+	    return;
+	}
+
+	for (int i = 0; i < n_collections; i++) collections[i]->dirty = true;
+	request_can_send_now();
     }
 
 private:
     int report_size;
     uint8_t *report;
 
-    uint8_t usage;
     static const int subclass = 0x580;
     static const int max_descriptor_len = 1024;
     uint8_t descriptor[max_descriptor_len];
-    std::list<HIDPage *> hid_pages;
+
+    static const int max_collections = 4;
+    HIDCollection *collections[max_collections];
+    int n_collections = 0;
+    int next_collection = 0;
+
+    static const int max_transports = 4;
+    HIDTransport *transports[max_transports];
+    int n_transports = 0;
+    std::atomic<uint8_t> connected{0};
+    HIDTransport *sending = NULL;
+    PiMutex *lock;
+
+    uint8_t transport_bit(HIDTransport *transport) {
+	for (int i = 0; i < n_transports; i++) {
+	    if (transports[i] == transport) return 1 << i;
+	}
+	return 0;
+    }
+
+    HIDTransport *active_transport() {
+	uint8_t connected_now = connected.load();
+	for (int i = 0; i < n_transports; i++) {
+	    if (connected_now & (1u << i)) return transports[i];
+	}
+	return NULL;
+    }
+
+    // Round robin over the changed collections so one busy player can't starve another
+    HIDCollection *next_dirty_collection() {
+	for (int i = 0; i < n_collections; i++) {
+	    int c = (next_collection + i) % n_collections;
+	    if (collections[c]->dirty) {
+		next_collection = (c + 1) % n_collections;
+		collections[c]->dirty = false;
+		return collections[c];
+	    }
+	}
+	return collections[0];
+    }
 };
 
+inline void HIDCollection::changed() {
+    dirty = true;
+    controller->request_can_send_now();
+}
+
+inline void HIDPage::request_can_send_now(HIDCollection *collection) {
+    TRACE(TRACE_REQUEST_CAN_SEND_NOW, 0);
+    collection->changed();
+}
+
 class Gamepad : public HIDController {
 public:
     Gamepad() : HIDController(0x04) {
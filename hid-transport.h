@@ -0,0 +1,32 @@
+#ifndef __HID_TRANSPORT_H__
+#define __HID_TRANSPORT_H__
+
+#include <stdint.h>
+
+class HIDController;
+
+/* Carries the reports of an HIDController to a host.  A controller can have
+ * several transports (eg USB and Bluetooth) and sends to the first one, in
+ * the order they were added, that has a host connected.
+ *
+ * A transport calls back into its controller with transport_connected(),
+ * transport_disconnected() and transport_can_send_now().
+ */
+
+class HIDTransport {
+public:
+    virtual ~HIDTransport() {}
+
+    // Reports are at most max_report_len bytes, including the report id when the controller uses them
+    virtual void start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) = 0;
+
+    // Asks for a call to transport_can_send_now() as soon as a report can be sent
+    virtual void request_send() = 0;
+
+    virtual void send(const uint8_t *report, int len) = 0;
+
+protected:
+    HIDController *controller = NULL;
+};
+
+#endif
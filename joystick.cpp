@@ -1,8 +1,13 @@
 #include "pi.h"
 #include "bluetooth/bluetooth.h"
 #include "deep-sleep.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "button-remap.h"
+#include "layers.h"
 #include "gamepad.h"
 #include "pico-joystick.h"
+#include "profile-store.h"
 
 class Sleeper : public DeepSleeper {
 public:
@@ -66,11 +71,22 @@ static struct {
 
 static const int n_buttons = sizeof(buttons) / sizeof(*buttons);
 
-static GPInput *get_button(const char *name) {
+static int get_button_index(const char *name) {
     for (int i = 0; i < n_buttons; i++) {
-	if (strcmp(buttons[i].name, name) == 0) return buttons[i].input;
+	if (strcmp(buttons[i].name, name) == 0) return i;
     }
-    return NULL;
+    return -1;
+}
+
+static GPInput *get_button(const char *name) {
+    int i = get_button_index(name);
+    return i < 0 ? NULL : buttons[i].input;
+}
+
+static uint32_t get_button_bit(const char *name) {
+    int i = get_button_index(name);
+    assert(i >= 0);
+    return 1u << i;
 }
 
 static void threads_main(int argc, char **argv) {
@@ -82,6 +98,8 @@ static void threads_main(int argc, char **argv) {
     GPInput *start  = get_button("start");
     GPInput *b1     = get_button("b1");
 
+    ProfileStore *profiles = new ProfileStore();
+
     pico_joystick_boot(b1, 10, start, "joystick");
 
     GPOutput *power_led = new GPOutput(19);
@@ -93,13 +111,35 @@ static void threads_main(int argc, char **argv) {
     joystick->initialize("Test Gamepad");
     bluetooth_start_gamepad("Pico Joystick");
 
+    ButtonRemap *builtin_remap = new ButtonRemap();
+    for (int i = 0; i < n_buttons; i++) builtin_remap->add(buttons[i].gpio, i);
+
+    // Holding meta makes b1, b2 and b3 auto-fire
+    LayerEngine *layers = new LayerEngine(get_button_bit("meta"));
+    int turbo = layers->add_layer(get_button_bit("meta"));
+    layers->set_turbo(turbo, get_button_bit("b1") | get_button_bit("b2") | get_button_bit("b3"));
+
+    const uint32_t valid_buttons = (1u << n_buttons) - 1;
+    const Profile *profile = NULL;
+    ProfileInputs *profile_inputs = new ProfileInputs();
+    const ButtonRemap *remap = builtin_remap;
+
     while (1) {
 	joystick->wait_connected();
-	hid_buttons->begin_transaction();
-	for (int i = 0; i < n_buttons; i++) {
-	    hid_buttons->set_button(i+1, buttons[i].input->get());
+
+	const Profile *active = profiles->acquire();
+	if (active != profile) {
+	    profile = active;
+	    profile_inputs->load(profile);
+	    remap = &profile_inputs->remap;
+	    printf("Loaded profile %s\n", profile->name);
 	}
-	hid_buttons->end_transaction();
+
+	uint32_t pressed = remap->remap(gpio_get_all());
+	const Layer *layer = layers->select(pressed);
+
+	// Unmapped buttons read 0 so masking with all of them releases any held across a profile switch
+	hid_buttons->set_buttons(layer->apply(pressed, LayerEngine::turbo_off(time_us_32())), valid_buttons);
     }
 }
 
@@ -0,0 +1,62 @@
+#include "pi.h"
+#include "layers.h"
+
+void Layer::compile() {
+    for (int byte = 0; byte < 2; byte++) {
+	for (int v = 0; v < 256; v++) {
+	    uint32_t out = 0;
+	    for (int i = 0; i < 8; i++) {
+		int to = dest[byte*8 + i];
+		if ((v & (1u << i)) && to >= 0) out |= (1u << to);
+	    }
+	    table[byte][v] = out;
+	}
+    }
+}
+
+LayerEngine::LayerEngine(uint32_t modifiers) : modifiers(modifiers) {
+    memset(modifier_index, 0, sizeof(modifier_index));
+    memset(layer_of, 0, sizeof(layer_of));
+
+    int n_modifiers = 0;
+    for (int bit = 0; bit < LAYER_MAX_BUTTONS; bit++) {
+	if ((modifiers & (1u << bit)) == 0) continue;
+	assert(n_modifiers < LAYER_MAX_MODIFIERS);
+
+	for (int v = 0; v < 256; v++) {
+	    if (v & (1u << (bit % 8))) modifier_index[bit / 8][v] |= (1u << n_modifiers);
+	}
+	n_modifiers++;
+    }
+
+    add_layer(0);
+}
+
+int LayerEngine::add_layer(uint32_t when_held) {
+    assert(n_layers < LAYER_MAX_LAYERS);
+
+    int id = n_layers++;
+    Layer *layer = &layers[id];
+
+    for (int bit = 0; bit < LAYER_MAX_BUTTONS; bit++) {
+	layer->dest[bit] = (modifiers & (1u << bit)) ? -1 : bit;
+    }
+    layer->turbo = 0;
+    layer->map = NULL;
+    layer->compile();
+
+    if (id > 0) {
+	when_held &= modifiers;
+	layer_of[modifier_index[0][when_held & 0xff] | modifier_index[1][(when_held >> 8) & 0xff]] = id;
+    }
+
+    return id;
+}
+
+void LayerEngine::remap(int layer, int from_bit, int to_bit) {
+    assert(layer >= 0 && layer < n_layers);
+    assert(from_bit >= 0 && from_bit < LAYER_MAX_BUTTONS);
+
+    layers[layer].dest[from_bit] = to_bit;
+    layers[layer].compile();
+}
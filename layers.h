@@ -0,0 +1,72 @@
+#ifndef __LAYERS_H__
+#define __LAYERS_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "profile-store.h"
+
+#define LAYER_MAX_BUTTONS	16
+#define LAYER_MAX_MODIFIERS	4
+#define LAYER_MAX_LAYERS	4
+
+/* A layer is a complete alternate layout: where each button goes, which
+ * buttons auto-fire and which stick map to use.  Everything is compiled into
+ * flat tables when the layer is configured so applying one is a couple of
+ * table loads no matter how many layers exist.
+ */
+
+class Layer {
+public:
+    uint32_t apply(uint32_t buttons, bool turbo_off) const {
+	uint32_t out = table[0][buttons & 0xff] | table[1][(buttons >> 8) & 0xff];
+	if (turbo_off) out &= ~turbo;
+	return out;
+    }
+
+    uint32_t turbo;
+    const Profile::Map *map;
+
+private:
+    friend class LayerEngine;
+
+    int8_t dest[LAYER_MAX_BUTTONS];
+    uint32_t table[2][256];
+
+    void compile();
+};
+
+/* Selects a layer from the modifier buttons that are held.  Button numbers
+ * are bits of the HIDButtons word (bit 0 is the first button id) and the
+ * modifiers themselves are never reported.
+ */
+
+class LayerEngine {
+public:
+    LayerEngine(uint32_t modifiers);
+
+    // Returns the new layer's id, layer 0 is the identity layout used when no modifiers are held
+    int add_layer(uint32_t when_held);
+
+    void remap(int layer, int from_bit, int to_bit);
+    void set_turbo(int layer, uint32_t bits) { layers[layer].turbo = bits; }
+    void set_map(int layer, const Profile::Map *map) { layers[layer].map = map; }
+
+    const Layer *get(int layer) const { return &layers[layer]; }
+
+    const Layer *select(uint32_t buttons) const {
+	uint32_t held = buttons & modifiers;
+	return &layers[layer_of[modifier_index[0][held & 0xff] | modifier_index[1][(held >> 8) & 0xff]]];
+    }
+
+    // Turbo buttons are released for 32ms out of every 64ms
+    static bool turbo_off(uint32_t now_us) { return (now_us >> 15) & 1; }
+
+private:
+    uint32_t modifiers;
+    int n_layers = 0;
+    Layer layers[LAYER_MAX_LAYERS];
+    uint8_t modifier_index[2][256];
+    uint8_t layer_of[1 << LAYER_MAX_MODIFIERS];
+};
+
+#endif
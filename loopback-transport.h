@@ -0,0 +1,51 @@
+#ifndef __LOOPBACK_TRANSPORT_H__
+#define __LOOPBACK_TRANSPORT_H__
+
+#include <string.h>
+#include "gamepad.h"
+#include "hid-transport.h"
+
+/* Stands in for a host so the whole page -> collection -> controller ->
+ * transport pipeline can run on Linux.  connect() plays the part of a host
+ * connecting and poll() the part of the stack saying it can take a report.
+ */
+
+class LoopbackTransport : public HIDTransport {
+public:
+    void start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) override {
+	this->controller = controller;
+	this->descriptor = descriptor;
+	this->descriptor_len = descriptor_len;
+    }
+
+    void request_send() override { requested = true; }
+
+    void send(const uint8_t *report, int len) override {
+	if (len > (int) sizeof(last_report)) len = sizeof(last_report);
+	memcpy(last_report, report, len);
+	last_report_len = len;
+	n_reports++;
+    }
+
+    void connect() { controller->transport_connected(this); }
+    void disconnect() { controller->transport_disconnected(this); }
+
+    // Delivers one pending report, returns false if nothing was requested
+    bool poll() {
+	if (! requested) return false;
+	requested = false;
+	controller->transport_can_send_now(this);
+	return true;
+    }
+
+    const uint8_t *descriptor = NULL;
+    int descriptor_len = 0;
+    uint8_t last_report[64];
+    int last_report_len = 0;
+    int n_reports = 0;
+
+private:
+    bool requested = false;
+};
+
+#endif
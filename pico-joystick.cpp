@@ -5,11 +5,12 @@
 #include "bluetooth/hid.h"
 #include "deep-sleep.h"
 #include "gp-output.h"
-#include "net-console.h"
-#include "net-listener.h"
+#include "console-server.h"
+#include "threads-console.h"
 #include "stdin-reader.h"
 #include "stdout-writer.h"
 #include "time-utils.h"
+#include "trace.h"
 #include "wifi.h"
 #include "gamepad.h"
 #include "pico-joystick.h"
@@ -24,7 +25,7 @@ public:
     }
 };
 
-Button::Button(int gpio, const char *name) : GPInput(gpio), PiThread(name) { 
+Button::Button(int gpio, const char *name) : GPInput(gpio), PiThread(name), stats(name) {
 }
 
 void Button::set_button_id(HIDButtons *buttons, int button_id) {
@@ -37,6 +38,8 @@ void Button::set_button_id(HIDButtons *buttons, int button_id) {
 }
 
 void Button::on_change(void) {
+    TRACE(TRACE_GPIO_ISR, button_id);
+    stats.wake_requested();
     resume_from_isr();
 }
 
@@ -51,6 +54,8 @@ void Button::main() {
 	    last_value = this_value;
 	}
 	pause();
+	TRACE(TRACE_THREAD_RESUME, button_id);
+	stats.running();
     }
 }
 
@@ -65,39 +70,13 @@ public:
     }
 
     void process_cmd(const char *cmd) override {
-        ThreadsConsole::process_cmd(cmd);
+	if (! ConsoleCommand::process_cmd(this, cmd)) ThreadsConsole::process_cmd(cmd);
     }
 
     void usage() override {
 	ThreadsConsole::usage();
 	write_str("usage: <button #> <0|1> | threads\n");
-    }
-};
-
-class NetConsoleThread : public NetConsole, public PiThread {
-public:
-    NetConsoleThread(int fd) : NetConsole(fd), PiThread("console") { start(); }
-
-    void main() {
-	NetConsole::main();
-    }
-
-    void process_cmd(const char *cmd) override {
-        NetConsole::process_cmd(cmd);
-    }
-
-    void usage() override {
-	NetConsole::usage();
-	write_str("usage: <button #> <0|1> | threads\n");
-    }
-};
-
-class NetListenerThread : NetListener {
-public:
-    NetListenerThread(uint16_t port) : NetListener(port) { start(); }
-
-    void accepted(int fd) {
-        new NetConsoleThread(fd);
+	ConsoleCommand::usage(this);
     }
 };
 
@@ -110,7 +89,7 @@ public:
     void main(void) override {
 	wifi_init(hostname);
         wifi_wait_for_connection();
-        new NetListenerThread(4567);
+        new ConsoleServer(4567);
     }
 
 private:
@@ -1,11 +1,14 @@
 #ifndef __PICO_JOYSTICK_H__
 #define __PICO_JOYSTICK_H__
 
+#include "console-command.h"
 #include "gp-input.h"
 #include "gp-output.h"
 #include "io.h"
 #include "gamepad.h"
 #include "pi-threads.h"
+#include "thread-stats.h"
+#include "writer.h"
 
 class Button : public GPInput, public InputNotifier, PiThread {
 public:
@@ -20,6 +23,7 @@ private:
     HIDButtons *buttons;
     int last_value = -1;
     int button_id = -1;
+    ThreadStats stats;
 };
 
 void pico_joystick_go_to_sleep();
@@ -0,0 +1,171 @@
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include "pi.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "profile-store.h"
+
+#define FLASH_TIMEOUT_MS 1000
+
+static uint32_t slot_offset(int slot) {
+    return PROFILE_SLOTS_OFFSET + slot * PROFILE_SLOT_SIZE;
+}
+
+struct ActiveRecord {
+    uint32_t magic;
+    int slot;
+};
+
+static const ActiveRecord *saved_active() {
+    return (const ActiveRecord *) (XIP_BASE + PROFILE_ACTIVE_OFFSET);
+}
+
+struct FlashOp {
+    uint32_t offset;
+    uint32_t erase_size;
+    const uint8_t *data;
+    uint32_t data_size;
+};
+
+static void flash_op(void *arg) {
+    FlashOp *op = (FlashOp *) arg;
+
+    flash_range_erase(op->offset, op->erase_size);
+    if (op->data) flash_range_program(op->offset, op->data, op->data_size);
+}
+
+/* Anything else builds a meaningless map, or in the case of rotation one that
+ * takes far too long to build.
+ */
+static bool geometry_ok(const ThumbstickGeometry &g) {
+    return g.dead_zone >= 0 && g.dead_zone <= 100 && g.diagonal >= 0 && g.diagonal <= 90 &&
+	g.same >= 0 && g.same <= 90 && g.rotation > -360 && g.rotation < 360;
+}
+
+ProfileStore::ProfileStore() : ConsoleCommand("profile", "list | show <slot> | activate <slot> | erase <slot> | set <slot> <name> <dead-zone> <diagonal> <same> <rotation> <gpio>..."), active_profile(NULL), in_use_profile(NULL) {
+    const ActiveRecord *saved = saved_active();
+    if (saved->magic != PROFILE_ACTIVE_MAGIC || ! use(saved->slot)) use(0);
+}
+
+const Profile *ProfileStore::get(int slot) {
+    if (slot < 0 || slot >= PROFILE_N_SLOTS) return NULL;
+    return (const Profile *) (XIP_BASE + slot_offset(slot));
+}
+
+bool ProfileStore::use(int slot) {
+    const Profile *profile = get(slot);
+    if (! profile || ! profile->is_valid()) return false;
+
+    active_profile.store(profile);
+    return true;
+}
+
+bool ProfileStore::activate(int slot) {
+    if (! use(slot)) return false;
+
+    const ActiveRecord *saved = saved_active();
+    if (saved->magic == PROFILE_ACTIVE_MAGIC && saved->slot == slot) return true;
+
+    static_assert(sizeof(ActiveRecord) <= FLASH_PAGE_SIZE, "active record must fit in a flash page");
+    uint8_t page[FLASH_PAGE_SIZE];
+    ActiveRecord *record = (ActiveRecord *) page;
+
+    memset(page, 0xff, sizeof(page));
+    record->magic = PROFILE_ACTIVE_MAGIC;
+    record->slot = slot;
+
+    // The profile is active either way, it just won't survive a reboot if this fails
+    FlashOp op = { PROFILE_ACTIVE_OFFSET, FLASH_SECTOR_SIZE, page, FLASH_PAGE_SIZE };
+    flash_safe_execute(flash_op, &op, FLASH_TIMEOUT_MS);
+    return true;
+}
+
+bool ProfileStore::write(int slot, const char *name, ThumbstickGeometry geometry, int n_buttons, const int8_t *gpio) {
+    const Profile *old = get(slot);
+    if (! old || is_busy(old) || n_buttons > PROFILE_MAX_BUTTONS || ! geometry_ok(geometry)) return false;
+
+    uint8_t *buf = (uint8_t *) fatal_malloc(PROFILE_SLOT_SIZE);
+    memset(buf, 0xff, PROFILE_SLOT_SIZE);
+
+    Profile *profile = (Profile *) buf;
+    profile->magic = PROFILE_MAGIC;
+    strncpy(profile->name, name, PROFILE_NAME_LEN);
+    profile->name[PROFILE_NAME_LEN-1] = '\0';
+    profile->geometry = geometry;
+    profile->n_buttons = n_buttons;
+    memcpy(profile->gpio, gpio, n_buttons);
+    new (&profile->map) Profile::Map(geometry);
+
+    FlashOp op = { slot_offset(slot), PROFILE_SLOT_SIZE, buf, PROFILE_SLOT_SIZE };
+    bool ok = flash_safe_execute(flash_op, &op, FLASH_TIMEOUT_MS) == PICO_OK;
+
+    fatal_free(buf);
+    return ok;
+}
+
+bool ProfileStore::erase(int slot) {
+    const Profile *old = get(slot);
+    if (! old || is_busy(old)) return false;
+
+    FlashOp op = { slot_offset(slot), PROFILE_SLOT_SIZE, NULL, 0 };
+    return flash_safe_execute(flash_op, &op, FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+void ProfileStore::dump(Writer *w, int slot) {
+    const Profile *profile = get(slot);
+
+    if (! profile->is_valid()) {
+	w->printf("%d: empty\n", slot);
+	return;
+    }
+
+    w->printf("%d: %s%s dead-zone %d diagonal %d same %d rotation %d gpios", slot, profile->name, profile == active() ? " (active)" : "",
+	profile->geometry.dead_zone, profile->geometry.diagonal, profile->geometry.same, profile->geometry.rotation);
+    for (int i = 0; i < profile->n_buttons; i++) w->printf(" %d", profile->gpio[i]);
+    w->printf("\n");
+}
+
+void ProfileStore::process(Writer *w, int argc, char **argv) {
+    int slot = argc > 2 ? atoi(argv[2]) : -1;
+
+    if (argc == 2 && strcmp(argv[1], "list") == 0) {
+	for (int i = 0; i < PROFILE_N_SLOTS; i++) dump(w, i);
+    } else if (argc == 3 && strcmp(argv[1], "show") == 0 && get(slot)) {
+	dump(w, slot);
+    } else if (argc == 3 && strcmp(argv[1], "activate") == 0) {
+	if (! activate(slot)) w->printf("No valid profile in slot %d\n", slot);
+    } else if (argc == 3 && strcmp(argv[1], "erase") == 0) {
+	if (! erase(slot)) w->printf("Failed to erase slot %d, it is active or still in use\n", slot);
+    } else if (argc >= 8 && strcmp(argv[1], "set") == 0) {
+	ThumbstickGeometry geometry = { atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atoi(argv[7]) };
+	int8_t gpio[PROFILE_MAX_BUTTONS];
+	int n_buttons = argc - 8;
+
+	if (n_buttons > PROFILE_MAX_BUTTONS) n_buttons = PROFILE_MAX_BUTTONS;
+	for (int i = 0; i < n_buttons; i++) gpio[i] = atoi(argv[8+i]);
+
+	if (! geometry_ok(geometry)) w->printf("dead-zone must be 0 to 100, diagonal and same 0 to 90 and rotation -359 to 359\n");
+	else if (! write(slot, argv[3], geometry, n_buttons, gpio)) w->printf("Failed to write slot %d, it is active or still in use\n", slot);
+	else dump(w, slot);
+    } else {
+	w->printf("usage: profile list | show <slot> | activate <slot> | erase <slot> | set <slot> <name> <dead-zone> <diagonal> <same> <rotation> <gpio>...\n");
+    }
+}
+
+void ProfileInputs::load(const Profile *profile) {
+    remap.clear();
+
+    for (int i = 0; i < profile->n_buttons; i++) {
+	int gpio = profile->gpio[i];
+
+	if (gpio < 0 || gpio >= max_gpio) continue;
+
+	if (! by_gpio[gpio]) {
+	    by_gpio[gpio] = new GPInput(gpio);
+	    by_gpio[gpio]->set_pullup_up();
+	    if (notifier) by_gpio[gpio]->set_notifier(notifier);
+	}
+	remap.add(gpio, i);
+    }
+}
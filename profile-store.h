@@ -0,0 +1,111 @@
+#ifndef __PROFILE_STORE_H__
+#define __PROFILE_STORE_H__
+
+#include <atomic>
+#include <string.h>
+#include "hardware/flash.h"
+#include "pico/btstack_flash_bank.h"
+#include "button-remap.h"
+#include "pico-joystick.h"
+#include "thumbstick-map.h"
+
+#define PROFILE_MAGIC		0x4a505246	// "JPRF"
+#define PROFILE_ACTIVE_MAGIC	0x4a504143	// "JPAC"
+#define PROFILE_MAP_BITS	6
+#define PROFILE_MAX_BUTTONS	16
+#define PROFILE_NAME_LEN	16
+#define PROFILE_N_SLOTS		4
+
+/* A profile is a button layout plus a thumbstick map for one game.  Profiles
+ * live in flash and are used in place through XIP, they are never copied to RAM.
+ */
+
+struct Profile {
+    typedef ThumbstickMap<PROFILE_MAP_BITS> Map;
+
+    uint32_t magic;
+    char name[PROFILE_NAME_LEN];
+    ThumbstickGeometry geometry;
+    int n_buttons;
+    int8_t gpio[PROFILE_MAX_BUTTONS];	// gpio of HID button #i+1 or -1 if it isn't wired
+    Map map;
+
+    bool is_valid() const { return magic == PROFILE_MAGIC; }
+};
+
+/* The slots sit just below BTstack's flash bank which holds the bluetooth
+ * pairing keys at the very end of flash, with a sector recording the active
+ * slot below them.  PROFILE_STORE_OFFSET is the start of all of it.
+ */
+#define PROFILE_SLOT_SIZE	((sizeof(Profile) + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE)
+#define PROFILE_SLOTS_OFFSET	(PICO_FLASH_BANK_STORAGE_OFFSET - PROFILE_N_SLOTS * PROFILE_SLOT_SIZE)
+#define PROFILE_ACTIVE_OFFSET	(PROFILE_SLOTS_OFFSET - FLASH_SECTOR_SIZE)
+#define PROFILE_STORE_OFFSET	PROFILE_ACTIVE_OFFSET
+
+static_assert(PICO_FLASH_BANK_STORAGE_OFFSET % FLASH_SECTOR_SIZE == 0, "BTstack's flash bank must start on a sector");
+static_assert(PROFILE_SLOTS_OFFSET + PROFILE_N_SLOTS * PROFILE_SLOT_SIZE <= PICO_FLASH_BANK_STORAGE_OFFSET, "profiles overlap BTstack's flash bank");
+static_assert(PROFILE_ACTIVE_OFFSET + FLASH_SECTOR_SIZE <= PROFILE_SLOTS_OFFSET, "the active slot overlaps the profiles");
+
+class ProfileStore : public ConsoleCommand {
+public:
+    ProfileStore();
+
+    const Profile *get(int slot);
+
+    /* The scan loop only ever loads this pointer so activating a profile
+     * never stalls it.
+     */
+    const Profile *active() { return active_profile.load(); }
+
+    // Also saved to flash so the profile is still active after a reboot
+    bool activate(int slot);
+
+    /* The scan loop calls this once per pass instead of active().  The
+     * profile it returns stays in use (it can't be erased or rewritten)
+     * until the scan loop's next call, even if another slot has been
+     * activated since.
+     */
+    const Profile *acquire() {
+	while (1) {
+	    const Profile *profile = active_profile.load();
+	    in_use_profile.store(profile);
+	    // Pairs with write() and erase() storing active and then checking in_use
+	    if (active_profile.load() == profile) return profile;
+	}
+    }
+
+    bool write(int slot, const char *name, ThumbstickGeometry geometry, int n_buttons, const int8_t *gpio);
+    bool erase(int slot);
+
+    void process(Writer *w, int argc, char **argv) override;
+
+private:
+    std::atomic<const Profile *> active_profile;
+    std::atomic<const Profile *> in_use_profile;
+
+    bool is_busy(const Profile *profile) { return profile == active() || profile == in_use_profile.load(); }
+    bool use(int slot);
+
+    void dump(Writer *w, int slot);
+};
+
+/* Configures the gpios of a profile and compiles its button remap once per
+ * activation so that the scan loop doesn't have to look anything up.
+ */
+
+class ProfileInputs {
+public:
+    // Every gpio the profile uses reports its edges to notifier (if not NULL)
+    ProfileInputs(InputNotifier *notifier = NULL) : notifier(notifier) { memset(by_gpio, 0, sizeof(by_gpio)); }
+
+    void load(const Profile *profile);
+
+    ButtonRemap remap;
+
+private:
+    static const int max_gpio = 30;
+    InputNotifier *notifier;
+    GPInput *by_gpio[max_gpio];
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "pi.h"
+#include "hardware/pio.h"
+#include "quadrature-encoder.h"
+#include "quadrature-encoder.pio.h"
+
+QuadratureEncoder::QuadratureEncoder(int pin_a, PIO pio) : pio(pio) {
+    static bool loaded[NUM_PIOS];
+
+    /* The program uses computed jumps so it has to be at offset 0, every
+     * encoder on a PIO shares the one copy and gets its own state machine.
+     */
+    if (! loaded[pio_get_index(pio)]) {
+	pio_add_program_at_offset(pio, &quadrature_encoder_program, 0);
+	loaded[pio_get_index(pio)] = true;
+    }
+    sm = pio_claim_unused_sm(pio, true);
+    quadrature_encoder_program_init(pio, sm, pin_a);
+}
+
+int32_t QuadratureEncoder::get_count() {
+    int32_t count = 0;
+
+    /* The state machine pushes continuously so drain the FIFO to get the
+     * newest count.  It refills within a few cycles if we empty it.
+     */
+    int n = pio_sm_get_rx_fifo_level(pio, sm) + 1;
+    while (n-- > 0) count = pio_sm_get_blocking(pio, sm);
+
+    return count;
+}
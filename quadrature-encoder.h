@@ -0,0 +1,27 @@
+#ifndef __QUADRATURE_ENCODER_H__
+#define __QUADRATURE_ENCODER_H__
+
+#include "hardware/pio.h"
+#include "quadrature.h"
+
+/* A quadrature encoder on pins pin_a and pin_a + 1 counted by a PIO state
+ * machine, so fast spins don't cost any CPU and no edges are missed.  Each
+ * full cycle of the two phases is 4 counts.
+ */
+
+class QuadratureEncoder {
+public:
+    QuadratureEncoder(int pin_a, PIO pio = pio0);
+
+    int32_t get_count();
+
+    // Counts since the last call
+    int32_t get_delta() { return accumulator.delta(get_count()); }
+
+private:
+    PIO pio;
+    uint sm;
+    QuadratureAccumulator accumulator;
+};
+
+#endif
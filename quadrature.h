@@ -0,0 +1,52 @@
+#ifndef __QUADRATURE_H__
+#define __QUADRATURE_H__
+
+#include <stdint.h>
+
+/* Platform independent model of quadrature-encoder.pio.  It decodes exactly
+ * like the state machine (same transition table) so the decoding and the
+ * accumulation into a spinner can be exercised and benchmarked on Linux
+ * (tools/quadrature-bench.cpp).  The count goes up when B leads A.
+ */
+
+class QuadratureModel {
+public:
+    // Feed one sample of the A and B pins
+    void sample(int a, int b) {
+	// Indexed by (previous << 2) | current with the pins as (B << 1) | A,
+	// the order that "in pins, 2" shifts them in
+	static const int8_t step[16] = {
+	     0, -1, +1,  0,
+	    +1,  0,  0, -1,
+	    -1,  0,  0, +1,
+	     0, +1, -1,  0,
+	};
+	int current = ((b & 1) << 1) | (a & 1);
+	count += step[(previous << 2) | current];
+	previous = current;
+    }
+
+    int32_t get_count() const { return count; }
+
+private:
+    int previous = 0;
+    int32_t count = 0;
+};
+
+/* Converts the free running 32-bit count of an encoder into deltas.  The
+ * count is allowed to wrap, the difference of two samples is still correct.
+ */
+
+class QuadratureAccumulator {
+public:
+    int32_t delta(int32_t count) {
+	int32_t d = (int32_t) ((uint32_t) count - (uint32_t) last);
+	last = count;
+	return d;
+    }
+
+private:
+    int32_t last = 0;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pi.h"
+#include "pico-joystick.h"
+#include "scan-scheduler.h"
+#include "trace.h"
+
+std::atomic<ScanScheduler *> ScanScheduler::all(NULL);
+
+ScanScheduler::ScanScheduler(const char *name, int active_ms, int idle_ms, int quiet_ms, int threshold) : name(name) {
+    edge = xSemaphoreCreateBinary();
+    configure(active_ms, idle_ms, quiet_ms, threshold);
+    last_activity = xTaskGetTickCount();
+
+    next = all.load(std::memory_order_relaxed);
+    while (! all.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void ScanScheduler::configure(int active_ms, int idle_ms, int quiet_ms, int threshold) {
+    this->active_ms = active_ms;
+    this->idle_ms = idle_ms;
+    this->quiet_ms = quiet_ms;
+    this->threshold = threshold;
+    quiet_ticks = pdMS_TO_TICKS(quiet_ms);
+}
+
+void ScanScheduler::watch(GPInput *input) {
+    input->set_notifier(this);
+}
+
+void ScanScheduler::on_change(void) {
+    BaseType_t woken = pdFALSE;
+
+    // Button ids start at 1 so 0 marks an edge on a scan loop's input
+    TRACE(TRACE_GPIO_ISR, 0);
+    last_activity = xTaskGetTickCountFromISR();
+    xSemaphoreGiveFromISR(edge, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void ScanScheduler::wait() {
+    bool idle = is_idle();
+
+    if (idle) n_idle++;
+    else n_active++;
+
+    TickType_t ticks = pdMS_TO_TICKS(idle ? idle_ms : active_ms);
+
+    // An active_ms of 0 scans flat out, only yielding to threads of the same priority
+    if (xSemaphoreTake(edge, ticks) == pdTRUE) {
+	n_edges++;
+	TRACE(TRACE_THREAD_RESUME, 0);
+    } else if (ticks == 0) taskYIELD();
+}
+
+class ScanCommand : public ConsoleCommand {
+public:
+    ScanCommand() : ConsoleCommand("scan", "[<name> <active-ms> <idle-ms> <quiet-ms> <threshold>]") {
+    }
+
+    void process(Writer *w, int argc, char **argv) override {
+	if (argc == 6) {
+	    for (ScanScheduler *s = ScanScheduler::get_all(); s; s = s->get_next()) {
+		if (strcmp(s->name, argv[1]) == 0) {
+		    s->configure(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+		    return;
+		}
+	    }
+	    w->printf("No scan loop named %s\n", argv[1]);
+	    return;
+	}
+
+	w->printf("%-16s %9s %7s %8s %9s %10s %10s %8s\n", "scan", "active-ms", "idle-ms", "quiet-ms", "threshold", "active", "idle", "edges");
+	for (ScanScheduler *s = ScanScheduler::get_all(); s; s = s->get_next()) {
+	    w->printf("%-16s %9d %7d %8d %9d %10lu %10lu %8lu%s\n", s->name, s->active_ms, s->idle_ms, s->quiet_ms, s->threshold,
+		(unsigned long) s->n_active, (unsigned long) s->n_idle, (unsigned long) s->n_edges, s->is_idle() ? " (idle)" : "");
+	}
+    }
+};
+
+static ScanCommand scan_command;
@@ -0,0 +1,65 @@
+#ifndef __SCAN_SCHEDULER_H__
+#define __SCAN_SCHEDULER_H__
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#include "gp-input.h"
+
+/* Paces a scan loop: every active_ms while its inputs are moving, dropping to
+ * every idle_ms once they have been still for quiet_ms.  An edge on any
+ * watched gpio ends the current wait immediately and switches back to the
+ * active rate, so a button press is never delayed by the idle rate.  Each
+ * scheduler serves exactly one thread.
+ *
+ * The "scan" console command shows how much time each loop spends at each
+ * rate and changes the rates.
+ */
+
+class ScanScheduler : public InputNotifier {
+public:
+    ScanScheduler(const char *name, int active_ms = 1, int idle_ms = 20, int quiet_ms = 2000, int threshold = 4);
+
+    // Call from the scanning thread, gpio interrupts are delivered to the core that sets the notifier
+    void watch(GPInput *input);
+
+    void wait();
+
+    void activity() { last_activity = xTaskGetTickCount(); }
+
+    // Treats a move of more than threshold counts as activity
+    void moved(int value, int *last) {
+	if (abs(value - *last) > threshold) {
+	    *last = value;
+	    activity();
+	}
+    }
+
+    void on_change(void) override;
+
+    void configure(int active_ms, int idle_ms, int quiet_ms, int threshold);
+
+    bool is_idle() { return xTaskGetTickCount() - last_activity > quiet_ticks; }
+
+    static ScanScheduler *get_all() { return all.load(std::memory_order_acquire); }
+    ScanScheduler *get_next() { return next; }
+
+    const char *name;
+    int active_ms, idle_ms, quiet_ms, threshold;
+    uint32_t n_active = 0;
+    uint32_t n_idle = 0;
+    uint32_t n_edges = 0;
+
+private:
+    SemaphoreHandle_t edge;
+    TickType_t quiet_ticks;
+    volatile TickType_t last_activity;
+    ScanScheduler *next;
+
+    static std::atomic<ScanScheduler *> all;
+};
+
+#endif
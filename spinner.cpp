@@ -1,68 +1,52 @@
 #include "pi.h"
 #include <math.h>
-#include "i2c.h"
 #include "bluetooth/bluetooth.h"
+#include "bluetooth/hid.h"
+#include "as5600.h"
 #include "gamepad.h"
 #include "pico-joystick.h"
 #include "pi-threads.h"
+#include "quadrature-encoder.h"
+#include "scan-scheduler.h"
 #include "random-utils.h"
 #include "time-utils.h"
 
-#define STATUS_REG 0x0B
-
-#define I2C_BUS		1
-#define I2C_SDA		2
-#define I2C_SCL		3
-
-static void ensure_magnet(int i2c) {
-    uint8_t last_status = 0;
-    while (1) {
-	uint8_t status;
-
-	if (i2c_read_byte(i2c, STATUS_REG, &status) < 0) {
-	    fprintf(stderr, "Failed to read the status register\n");
-	    assert(0);
-	}
-
-	bool md = (status & 0x20) != 0;
-	bool ml = (status & 0x10) != 0;
-	bool mh = (status & 0x08) != 0;
-	if (md) {
-	    fprintf(stderr, "Magnet detected.\n");
-	    break;
-	} else if (mh) {
-	    if (status != last_status) fprintf(stderr, "Magnet is too close to the sensor\n");
-	} else if (ml) {
-	    if (status != last_status) fprintf(stderr, "Magnet is too far from the sensor\n");
-	} else {
-	    if (status != last_status) fprintf(stderr, "Unexpected status response: 0x%02x.\n", status);
-	}
-	last_status = status;
-	ms_sleep(100);
-    }
-}
-
-static double read_angle(int i2c) {
-    uint8_t low_byte, high_nibble;
-    static uint16_t last_value = 0;
-
-    i2c_read_byte(i2c, 0x0c, &high_nibble);
-    i2c_read_byte(i2c, 0x0d, &low_byte);
-
-    uint16_t value = (high_nibble << 8) | low_byte;
-    if (value >= 4096) {
-	value = last_value;
-    } else if (-2 <= (value - last_value) && (value - last_value) <= 2) {
-	value = last_value;
-    } else {
-        last_value = value;
-    }
-    return value / 4095.0;
-}
+/* One entry per AS5600.  Each bus is sampled by its own thread so sensors on
+ * different buses don't slow each other down.  A bus can only have one
+ * sensor unless all of its sensors are behind a TCA9548A mux (mux channel
+ * 0-7): an unmuxed sensor would answer alongside whichever channel is on.
+ */
+
+enum { SPINNER_X, SPINNER_Y, PADDLE };
+
+static const struct {
+    const char *name;
+    int bus;
+    int mux_channel;
+    int target;
+} sensor_config[] = {
+    { "spinner-1", 1, AS5600_NO_MUX, SPINNER_X },
+//  { "spinner-2", 0, 0, SPINNER_Y },
+//  { "paddle", 0, 1, PADDLE },
+};
+
+#define N_SENSORS	(sizeof(sensor_config) / sizeof(sensor_config[0]))
+
+static const struct {
+    int sda, scl;
+} bus_pins[2] = {
+    { 8, 9 },
+    { 2, 3 },
+};
+
+/* Use a quadrature encoder (A on QUADRATURE_PIN_A, B on the next gpio)
+ * instead of the AS5600s.  Counts per revolution is 4x the encoder's PPR.
+ */
+#define USE_QUADRATURE		0
+#define QUADRATURE_PIN_A	6
+#define QUADRATURE_COUNTS_PER_REV	(4 * 600)
 
 static void threads_main(int argc, char **argv) {
-    int i2c;
-
 #if 1
     bluetooth_init();
     hid_init();
@@ -70,25 +54,61 @@ static void threads_main(int argc, char **argv) {
     pico_joystick_boot();
 #endif
 
-    i2c_init_bus(I2C_BUS, I2C_SDA, I2C_SCL);
-    if ((i2c = i2c_open(I2C_BUS, 0x36)) < 0) {
-	fprintf(stderr, "Failed to open the i2c device.\n");
-	assert(0);
-    }
+#if USE_QUADRATURE
+    QuadratureEncoder *encoder = new QuadratureEncoder(QUADRATURE_PIN_A);
+#endif
 
     GPInput *button = new GPInput(5);
     button->set_pullup_up();
 
+    ScanScheduler *scheduler = new ScanScheduler("spinner", 2, 20);
+    scheduler->watch(button);
+
     Mouse *mouse = new Mouse();
     HIDButtons *buttons = new HIDButtons(mouse, 1, 1);
     mouse->add_hid_page(buttons);
     HIDSpinner *spinner = new HIDSpinner(mouse);
     mouse->add_hid_page(spinner);
 
+#if ! USE_QUADRATURE
+    static const uint8_t paddle_usages[] = { 0x36, 0x37 };	// Slider, Dial
+    HIDAxes *paddles = NULL;
+    int n_paddles = 0;
+    AS5600Bus *buses[2] = { NULL, NULL };
+
+    for (size_t i = 0; i < N_SENSORS; i++) {
+	if (sensor_config[i].target == PADDLE) n_paddles++;
+    }
+    assert(n_paddles <= (int) sizeof(paddle_usages));
+
+    if (n_paddles) {
+	paddles = new HIDAxes(mouse, n_paddles, paddle_usages, 12, false);
+	mouse->add_hid_page(paddles);
+    }
+
+    for (size_t i = 0, paddle = 0; i < N_SENSORS; i++) {
+	int bus = sensor_config[i].bus;
+	AS5600 *sensor = new AS5600(sensor_config[i].name, sensor_config[i].mux_channel);
+
+	if (sensor_config[i].target == PADDLE) {
+	    sensor->to_paddle(paddles, paddle++);
+	} else {
+	    sensor->to_spinner(spinner, sensor_config[i].target == SPINNER_Y);
+	}
+
+	if (! buses[bus]) buses[bus] = new AS5600Bus(bus, bus_pins[bus].sda, bus_pins[bus].scl);
+	buses[bus]->add(sensor);
+    }
+#endif
+
     mouse->initialize("spinner");
     bluetooth_start(hid_subclass_mouse, "Pico Spinner");
 
-    ensure_magnet(i2c);
+#if ! USE_QUADRATURE
+    for (int bus = 0; bus < 2; bus++) {
+	if (buses[bus]) buses[bus]->start();
+    }
+#endif
 
     while (1) {
 #if 0
@@ -102,11 +122,15 @@ static double position = 0;
 
 	spinner->set_position(position);
 	//buttons->set_button(1, random_number_in_range(0, 1));
+#elif USE_QUADRATURE
+	int counts = encoder->get_delta();
+	if (counts) scheduler->activity();
+	spinner->add_counts(counts, QUADRATURE_COUNTS_PER_REV);
+	buttons->set_button(1, button->get());
 #else
-	spinner->set_position(read_angle(i2c));
 	buttons->set_button(1, button->get());
 #endif
-	ms_sleep(10);
+	scheduler->wait();
 
     }
 }
@@ -2,15 +2,21 @@
 #include <math.h>
 #include "pico-adc.h"
 #include "bluetooth/bluetooth.h"
+#include "calibration.h"
+#include "filter.h"
 #include "gamepad.h"
 #include "pico-joystick.h"
 #include "pi-threads.h"
+#include "scan-scheduler.h"
 #include "time-utils.h"
 
 #include "random-utils.h"
 
 #define ANALOG_JOYSTICK 0
 
+/* Fraction of the (calibrated) throw from the center before a direction is pressed */
+#define DEAD_ZONE 0.15
+
 Button *configure_test_button(Button *button) {
     button->set_pullup_up();
     return button;
@@ -21,7 +27,7 @@ static void threads_main(int argc, char **argv) {
 
     Gamepad *gp = new Gamepad();
     HIDButtons *buttons = new HIDButtons(gp, 1, 8);
-    HIDXY *xy = new HIDXY(gp);
+    HIDXY *xy = new HIDXY(gp, 12);
 
     GPInput *four_way = new GPInput(5);
     four_way->set_pullup_up();
@@ -37,14 +43,29 @@ static void threads_main(int argc, char **argv) {
     bluetooth_start_gamepad("Test Gamepad");
 
     ADC *adc = new PicoADC();
+    AdaptiveFilter x_filter(32, 16, "stick-x");
+    AdaptiveFilter y_filter(32, 16, "stick-y");
+    Calibration *calibration = new Calibration(2);
+
+    ScanScheduler *scheduler = new ScanScheduler("test-gamepad");
+    scheduler->watch(four_way);
+    int last_x = 0, last_y = 0;
 
     while (1) {
-	double x = adc->read_percentage(0);
-	double y = adc->read_percentage(1);
+	scheduler->wait();
+
+	int x_counts = calibration->apply(0, x_filter.filter(adc->read_percentage(0) * 4095));
+	int y_counts = calibration->apply(1, y_filter.filter(adc->read_percentage(1) * 4095));
+
+	scheduler->moved(x_counts, &last_x);
+	scheduler->moved(y_counts, &last_y);
 
 #if ANALOG_JOYSTICK
-	xy->move(x, y);
+	xy->move_counts(x_counts, y_counts, 12);
 #else
+	double x = x_counts / 4095.0;
+	double y = y_counts / 4095.0;
+
 	buttons->begin_transaction();
 	buttons->set_button(4, false);
 	buttons->set_button(5, false);
@@ -55,21 +76,23 @@ static void threads_main(int argc, char **argv) {
 	double abs_y = fabs(y - 0.5);
 
 	if (four_way->get()) {
-	    if (abs_x > 0.25 && abs_x > abs_y) {
+	    if (abs_x > DEAD_ZONE && abs_x > abs_y) {
 		buttons->set_button(x > 0.5 ? 4 : 5, true);
-	    } else if (abs_y > 0.25) {
+	    } else if (abs_y > DEAD_ZONE) {
 		buttons->set_button(y > 0.5 ? 6 : 7, true);
 	    }
 	} else {
-	    if (abs_x > 0.25) {
+	    if (abs_x > DEAD_ZONE) {
 		buttons->set_button(x > 0.5 ? 4 : 5, true);
 	    }
-	    if (abs_y > 0.25) {
+	    if (abs_y > DEAD_ZONE) {
 		buttons->set_button(y > 0.5 ? 6 : 7, true);
 	    }
 	}
 	buttons->end_transaction();
 #endif
+
+	calibration->save_if_idle(scheduler->is_idle());
     }
 }
     
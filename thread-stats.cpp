@@ -0,0 +1,104 @@
+#include <string.h>
+#include "pi.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico-joystick.h"
+#include "thread-stats.h"
+
+std::atomic<ThreadStats *> ThreadStats::all(NULL);
+
+ThreadStats::ThreadStats(const char *name) : name(name) {
+    next = all.load(std::memory_order_relaxed);
+    while (! all.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+#if configUSE_TRACE_FACILITY
+
+#ifndef configRUN_TIME_COUNTER_TYPE
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+#endif
+
+class ThreadsCommand : public ConsoleCommand {
+public:
+    ThreadsCommand() : ConsoleCommand("threads", "[reset]") {
+    }
+
+    void process(Writer *w, int argc, char **argv) override {
+	bool reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+
+	UBaseType_t n_tasks = uxTaskGetNumberOfTasks();
+	TaskStatus_t *status = (TaskStatus_t *) fatal_malloc(n_tasks * sizeof(*status));
+	configRUN_TIME_COUNTER_TYPE total_run_time;
+
+	n_tasks = uxTaskGetSystemState(status, n_tasks, &total_run_time);
+
+	if (reset) {
+	    n_baselines = 0;
+	    for (UBaseType_t i = 0; i < n_tasks && i < max_baselines; i++) {
+		baselines[n_baselines].task_number = status[i].xTaskNumber;
+		baselines[n_baselines].run_time = status[i].ulRunTimeCounter;
+		n_baselines++;
+	    }
+	    total_baseline = total_run_time;
+	    for (ThreadStats *stats = ThreadStats::get_all(); stats; stats = stats->get_next()) stats->reset();
+	    fatal_free(status);
+	    return;
+	}
+
+	uint32_t total = total_run_time - total_baseline;
+
+	w->printf("%-16s %4s %6s %10s %6s %8s %8s %8s\n", "thread", "prio", "cpu%", "run-time", "stack", "wakeups", "avg-lat", "max-lat");
+	for (UBaseType_t i = 0; i < n_tasks; i++) {
+	    TaskStatus_t *t = &status[i];
+	    uint32_t run_time = t->ulRunTimeCounter - get_baseline(t->xTaskNumber);
+	    uint32_t pct_x10 = total ? (uint64_t) run_time * 1000 / total : 0;
+
+#if configGENERATE_RUN_TIME_STATS
+	    w->printf("%-16s %4d %4lu.%lu %10lu %6lu", t->pcTaskName, (int) t->uxCurrentPriority, (unsigned long) pct_x10 / 10, (unsigned long) pct_x10 % 10,
+		(unsigned long) run_time, (unsigned long) t->usStackHighWaterMark * sizeof(StackType_t));
+#else
+	    /* No run time counter in this build, don't pass off zeros as idle */
+	    (void) pct_x10;
+	    w->printf("%-16s %4d %6s %10s %6lu", t->pcTaskName, (int) t->uxCurrentPriority, "-", "-",
+		(unsigned long) t->usStackHighWaterMark * sizeof(StackType_t));
+#endif
+
+	    ThreadStats *stats = find_stats(t->pcTaskName);
+	    if (stats) {
+		uint32_t avg = stats->n_latencies ? stats->total_latency_us / stats->n_latencies : 0;
+		w->printf(" %8lu %6luus %6luus", (unsigned long) stats->n_wakeups, (unsigned long) avg, (unsigned long) stats->max_latency_us);
+	    }
+	    w->printf("\n");
+	}
+
+	fatal_free(status);
+    }
+
+private:
+    static const int max_baselines = 32;
+    struct {
+	UBaseType_t task_number;
+	configRUN_TIME_COUNTER_TYPE run_time;
+    } baselines[max_baselines];
+    int n_baselines = 0;
+    configRUN_TIME_COUNTER_TYPE total_baseline = 0;
+
+    configRUN_TIME_COUNTER_TYPE get_baseline(UBaseType_t task_number) {
+	for (int i = 0; i < n_baselines; i++) {
+	    if (baselines[i].task_number == task_number) return baselines[i].run_time;
+	}
+	return 0;
+    }
+
+    ThreadStats *find_stats(const char *task_name) {
+	for (ThreadStats *stats = ThreadStats::get_all(); stats; stats = stats->get_next()) {
+	    if (strncmp(stats->name, task_name, configMAX_TASK_NAME_LEN - 1) == 0) return stats;
+	}
+	return NULL;
+    }
+};
+
+static ThreadsCommand threads_command;
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __THREAD_STATS_H__
+#define __THREAD_STATS_H__
+
+#include <atomic>
+#include <stdint.h>
+#include "hardware/timer.h"
+
+/* Wakeup accounting for a thread.  The thread (or the ISR that wakes it)
+ * calls wake_requested() just before resuming it and the thread calls
+ * running() once it runs again which gives the scheduling latency.  The
+ * "threads" console command shows these next to the scheduler's own CPU
+ * time and stack numbers.  Tasks we don't own (the wifi driver, lwip,
+ * the one-shot start-wifi thread) only get the scheduler's numbers.
+ */
+
+class ThreadStats {
+public:
+    ThreadStats(const char *name);
+
+    void wake_requested() {
+	if (! requested_us) requested_us = time_us_32() | 1;
+    }
+
+    void running() {
+	n_wakeups++;
+	if (requested_us) {
+	    uint32_t latency = time_us_32() - requested_us;
+	    total_latency_us += latency;
+	    if (latency > max_latency_us) max_latency_us = latency;
+	    n_latencies++;
+	    requested_us = 0;
+	}
+    }
+
+    void reset() {
+	n_wakeups = n_latencies = 0;
+	total_latency_us = max_latency_us = 0;
+    }
+
+    static ThreadStats *get_all() { return all.load(std::memory_order_acquire); }
+    ThreadStats *get_next() { return next; }
+
+    const char *name;
+    uint32_t n_wakeups = 0;
+    uint32_t n_latencies = 0;
+    uint32_t total_latency_us = 0;
+    uint32_t max_latency_us = 0;
+
+private:
+    volatile uint32_t requested_us = 0;
+    ThreadStats *next;
+
+    static std::atomic<ThreadStats *> all;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef __THUMBSTICK_MAP_H__
+#define __THUMBSTICK_MAP_H__
+
+#include <stdint.h>
+
+#define CENTER 0
+#define UP    (1 << 0)
+#define DOWN  (1 << 1)
+#define LEFT  (1 << 2)
+#define RIGHT (1 << 3)
+#define SAME  (1 << 4)
+
+#define DIRECTIONS (UP | DOWN | LEFT | RIGHT)
+
+/* Declarative description of a thumbstick map.  Angles are in degrees and
+ * the dead zone is a percentage of the throw from the center to the edge.
+ */
+
+struct ThumbstickGeometry {
+    int dead_zone;	// radius around the center that reports no direction
+    int diagonal;	// width of each diagonal sector, 0 for a 4-way map
+    int same;		// width of the gate at each sector boundary that keeps the last action
+    int rotation;	// rotate the sectors clockwise (45 for a qbert style map)
+};
+
+/* A (1 << BITS) x (1 << BITS) lookup table built at compile time from a
+ * ThumbstickGeometry.  It is indexed directly with raw ADC counts, row 0 is
+ * "up" and column 0 is "left".
+ */
+
+template<int BITS, int ADC_BITS = 12>
+class ThumbstickMap {
+public:
+    static const int N = 1 << BITS;
+    static const int SHIFT = ADC_BITS - BITS;
+
+    constexpr ThumbstickMap(ThumbstickGeometry g) : map() {
+	for (int y = 0; y < N; y++) {
+	    for (int x = 0; x < N; x++) {
+		map[x + y*N] = action_at(g, 2*x + 1 - N, N - (2*y + 1));
+	    }
+	}
+    }
+
+    uint8_t lookup(uint16_t x_raw, uint16_t y_raw) const {
+	return map[(x_raw >> SHIFT) | ((y_raw >> SHIFT) << BITS)];
+    }
+
+    uint8_t get(int x, int y) const {
+	return map[x + y*N];
+    }
+
+private:
+    uint8_t map[N * N];
+
+    // dx and dy are measured in half cells from the center of the table.
+    static constexpr uint8_t action_at(ThumbstickGeometry g, int dx, int dy) {
+	int r = g.dead_zone * N / 100;
+	if (dx*dx + dy*dy < r*r) return CENTER;
+
+	double theta = atan2_degrees(dy, dx) + g.rotation;
+	while (theta >= 360) theta -= 360;
+	while (theta < 0) theta += 360;
+
+	int cardinal = (int) ((theta + 45) / 90) % 4;
+	double off = theta - cardinal * 90;
+	if (off > 180) off -= 360;
+
+	double half_cardinal = (90 - g.diagonal) / 2.0;
+	double abs_off = off < 0 ? -off : off;
+	double gate = abs_off - half_cardinal;
+
+	if (2*gate < g.same && -2*gate < g.same) return SAME;
+
+	const uint8_t directions[4] = { RIGHT, UP, LEFT, DOWN };
+	uint8_t action = directions[cardinal];
+	if (gate > 0) action |= directions[(cardinal + (off > 0 ? 1 : 3)) % 4];
+	return action;
+    }
+
+    // Good to about 0.25 degrees which is well below the resolution of the table.
+    static constexpr double atan2_degrees(double y, double x) {
+	double ax = x < 0 ? -x : x;
+	double ay = y < 0 ? -y : y;
+	if (ax == 0 && ay == 0) return 0;
+
+	double z = ax > ay ? ay / ax : ax / ay;
+	double a = 45 * z + 15.66 * z * (1 - z);
+
+	if (ay > ax) a = 90 - a;
+	if (x < 0) a = 180 - a;
+	if (y < 0) a = 360 - a;
+	return a;
+    }
+};
+
+#endif
@@ -1,76 +1,32 @@
 #include "pi.h"
 #include "bluetooth/bluetooth.h"
+#include "calibration.h"
 #include "deep-sleep.h"
+#include "filter.h"
 #include "gamepad.h"
-#include "pico-adc.h"
 #include "pico-joystick.h"
-
-#define N_REGIONS 9
-
-#define CENTER 0
-#define UP    (1 << 0)
-#define DOWN  (1 << 1)
-#define LEFT  (1 << 2)
-#define RIGHT (1 << 3)
-#define SAME  (1 << 4)
-
-#define UL (UP | LEFT)
-#define UR (UP | RIGHT)
-#define LT (LEFT)
-#define RT (RIGHT)
-#define DL (DOWN | LEFT)
-#define DW (DOWN)
-#define DR (DOWN | RIGHT)
-#define SM (SAME)
-#define NO (CENTER)
-
-static uint8_t map_8_way[N_REGIONS * N_REGIONS] = {
-    UL, UL, UL, UP, UP, UP, UR, UR, UR,
-    UL, UL, UL, UP, UP, UP, UR, UR, UR,
-    UL, UL, UL, UP, UP, UP, UR, UR, UR,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    DL, DL, DL, DW, DW, DW, DR, DR, DR,
-    DL, DL, DL, DW, DW, DW, DR, DR, DR,
-    DL, DL, DL, DW, DW, DW, DR, DR, DR,
-};
-
-static uint8_t map_4_way[N_REGIONS * N_REGIONS] = {
-    SM, UP, UP, UP, UP, UP, UP, UP, SM,
-    LT, SM, UP, UP, UP, UP, UP, SM, RT,
-    LT, LT, SM, UP, UP, UP, SM, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, SM, DW, DW, DW, SM, RT, RT,
-    LT, SM, DW, DW, DW, DW, DW, SM, RT,
-    SM, DW, DW, DW, DW, DW, DW, DW, SM,
-};
-
-static uint8_t map_qbert[N_REGIONS * N_REGIONS] = {
-    LT, LT, LT, LT, SM, UP, UP, UP, UP,
-    LT, LT, LT, LT, SM, UP, UP, UP, UP,
-    LT, LT, LT, LT, NO, UP, UP, UP, UP,
-    LT, LT, LT, NO, NO, NO, UP, UP, UP,
-    SM, SM, NO, NO, NO, NO, NO, SM, SM,
-    DW, DW, DW, NO, NO, NO, RT, RT, RT,
-    DW, DW, DW, DW, NO, RT, RT, RT, RT,
-    DW, DW, DW, DW, SM, RT, RT, RT, RT,
-    DW, DW, DW, DW, SM, RT, RT, RT, RT,
-};
-
-static uint8_t map_prefer_diagonals[N_REGIONS * N_REGIONS] = {
-    UL, UL, SM, UP, UP, UP, SM, UR, UR,
-    UL, UL, UL, UP, UP, UP, UR, UR, UR,
-    SM, UL, UL, SM, UP, SM, UR, UR, SM,
-    LT, LT, SM, UL, NO, UR, SM, RT, RT,
-    LT, LT, LT, NO, NO, NO, RT, RT, RT,
-    LT, LT, SM, DL, NO, DR, SM, RT, RT,
-    SM, DL, DL, SM, DW, SM, DR, DR, SM,
-    DL, DL, DL, DW, DW, DW, DR, DR, DR,
-    DL, DL, SM, DW, DW, DW, SM, DR, DR,
-};
+#include "profile-store.h"
+#include "scan-scheduler.h"
+#include "thumbstick-map.h"
+#include "zone-profiler.h"
+#include "hardware/adc.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "button-remap.h"
+#include "layers.h"
+
+/* Report the stick as a hat switch instead of buttons #1 to #4 */
+#define DIRECTIONS_AS_HAT 0
+
+typedef Profile::Map Map;
+
+/* The stick is calibrated so its center and full throw are known, the dead
+ * zone only has to cover the play around the center.
+ */
+static constexpr Map map_8_way({ 15, 45, 0, 0 });
+static constexpr Map map_4_way({ 15, 0, 8, 0 });
+static constexpr Map map_qbert({ 15, 0, 8, 45 });
+static constexpr Map map_prefer_diagonals({ 15, 60, 8, 0 });
 
 class Sleeper : public DeepSleeper {
 public:
@@ -133,22 +89,30 @@ static struct {
 
 static const int n_buttons = sizeof(buttons) / sizeof(*buttons);
 
-static GPInput *get_button(const char *name) {
+static int get_button_index(const char *name) {
     for (int i = 0; i < n_buttons; i++) {
-	if (strcmp(buttons[i].name, name) == 0) return buttons[i].input;
+	if (strcmp(buttons[i].name, name) == 0) return i;
     }
-    return NULL;
+    return -1;
 }
 
-static void dump_map(uint8_t *map) {
-    for (int y = 0; y < N_REGIONS; y++) {
-	if (y == 3 || y == 6) {
-	    for (int i = 0; i < N_REGIONS + 3; i++) printf("-");
-	    printf("\n");
-	}
-	for (int x = 0; x < N_REGIONS; x++) {
-	    uint8_t action = map[x + y*N_REGIONS];
-	    if (x == 3 || x == 6) printf("|");
+static GPInput *get_button(const char *name) {
+    int i = get_button_index(name);
+    return i < 0 ? NULL : buttons[i].input;
+}
+
+static uint32_t get_button_bit(const char *name) {
+    int i = get_button_index(name);
+    assert(i >= 0);
+    return 1u << i;
+}
+
+static void dump_map(const Map *map) {
+    const int step = Map::N / 16;
+
+    for (int y = 0; y < Map::N; y += step) {
+	for (int x = 0; x < Map::N; x += step) {
+	    uint8_t action = map->get(x, y);
 	    if (action == SAME) printf("|same");
 	    else printf("|%s%s%s%s", (action & LEFT) ? "L" : " ", (action & RIGHT) ? "R" : " ", (action & UP) ? "U" : " ", (action & DOWN) ? "D" : " ");
 	}
@@ -156,85 +120,164 @@ static void dump_map(uint8_t *map) {
     }
 }
 
+static uint16_t read_raw(int channel) {
+    adc_select_input(channel);
+    return adc_read();
+}
+
 static void threads_main(int argc, char **argv) {
+    ButtonRemap *builtin_remap = new ButtonRemap();
+
     for (int i = 0; i < n_buttons; i++) {
 	if (buttons[i].gpio >= 0) {
 	    printf("Initializing %s on %d\n", buttons[i].name, buttons[i].gpio);
 	    buttons[i].input = new GPInput(buttons[i].gpio);
 	    buttons[i].input->set_pullup_up();
 	}
+	builtin_remap->add(buttons[i].gpio, i);
     }
 
-    ADC *adc = new PicoADC();
+    adc_init();
+    adc_gpio_init(26 + 1);
+    adc_gpio_init(26 + 2);
 
     GPInput *start  = get_button("start");
     GPInput *select = get_button("select");
     GPInput *b1     = get_button("b1");
     GPInput *b2     = get_button("b2");
-    GPInput *program_mode = get_button("program-mode");
 
     if (start == NULL) printf("FAILED TO GET START\n");
     if (select == NULL) printf("FAILED TO GET SELECT\n");
     if (b1 == NULL) printf("FAILED TO GET B1\n");
     if (b2 == NULL) printf("FAILED TO GET B2\n");
-    if (program_mode == NULL) printf("FAILED TO GET PROGRAM-MODE\n");
+
+    ProfileStore *profiles = new ProfileStore();
+    ScanScheduler *scheduler = new ScanScheduler("thumbstick");
+
+    for (int i = 0; i < n_buttons; i++) {
+	if (buttons[i].input) scheduler->watch(buttons[i].input);
+    }
 
     pico_joystick_boot(b1, 13, start, "joystick");
 
     Joystick *joystick = new Joystick(new Sleeper(2));
     HIDButtons *hid_buttons = new HIDButtons(joystick, 1, n_buttons+1);
     joystick->add_hid_page(hid_buttons);
+#if DIRECTIONS_AS_HAT
+    HIDHat *hat = new HIDHat(joystick);
+    joystick->add_hid_page(hat);
+#endif
     joystick->initialize("Pico Thumbstick");
     bluetooth_start_gamepad("Pico Thumbstick");
 
-    uint8_t *map = map_8_way;
+    AdaptiveFilter x_filter(32, 16, "stick-x");
+    AdaptiveFilter y_filter(32, 16, "stick-y");
+    Calibration *calibration = new Calibration(2);
+
+    /* Holding program-mode reports nothing, instead b1, b2, start or select
+     * picks the map of the base layer.  Holding meta (not wired on this board
+     * but a profile can assign it a gpio) switches to the 4-way map and makes
+     * b1 and b2 auto-fire.
+     */
+    LayerEngine *layers = new LayerEngine(get_button_bit("program-mode") | get_button_bit("meta"));
+    layers->set_map(0, &map_8_way);
+
+    int program_layer = layers->add_layer(get_button_bit("program-mode"));
+    for (int i = 0; i < n_buttons; i++) layers->remap(program_layer, i, -1);
+
+    static const struct {
+	const char *button;
+	const Map *map;
+    } program_maps[] = {
+	{ "b1", &map_8_way },
+	{ "b2", &map_4_way },
+	{ "start", &map_qbert },
+	{ "select", &map_prefer_diagonals },
+    };
+
+    int meta_layer = layers->add_layer(get_button_bit("meta"));
+    layers->set_map(meta_layer, &map_4_way);
+    layers->set_turbo(meta_layer, get_button_bit("b1") | get_button_bit("b2"));
+
+    const uint32_t valid_buttons = (1u << n_buttons) - 1;
+    uint32_t directions = 0;
+    int last_x = 0, last_y = 0;
+    const Profile *profile = NULL;
+    ProfileInputs *profile_inputs = new ProfileInputs(scheduler);
+    const ButtonRemap *remap = builtin_remap;
 
     printf("Initial map:\n");
-    dump_map(map);
+    dump_map(layers->get(0)->map);
 
     while (1) {
 	joystick->wait_connected();
+	scheduler->wait();
+
+	const Profile *active = profiles->acquire();
+	if (active != profile) {
+	    profile = active;
+	    profile_inputs->load(profile);
+	    remap = &profile_inputs->remap;
+	    layers->set_map(0, &profile->map);
+	    printf("Loaded profile %s:\n", profile->name);
+	    dump_map(&profile->map);
+	}
 
-	if (program_mode->get()) {
-	    uint8_t *new_map = map;
+	PROFILE_ZONE("scan");
 
-	    if (b1->get()) new_map = map_8_way;
-	    else if (b2->get()) new_map = map_4_way;
-	    else if (start->get()) new_map = map_qbert;
-	    else if (select->get()) new_map = map_prefer_diagonals;
+	uint32_t pressed = remap->remap(gpio_get_all());
+	const Layer *layer = layers->select(pressed);
 
-	    if (new_map != map) {
-		map = new_map;
-		printf("Loaded map:\n");
-	        dump_map(map);
+	if (layer == layers->get(program_layer)) {
+	    for (size_t i = 0; i < sizeof(program_maps) / sizeof(*program_maps); i++) {
+		if ((pressed & get_button_bit(program_maps[i].button)) == 0) continue;
+		if (layers->get(0)->map != program_maps[i].map) {
+		    layers->set_map(0, program_maps[i].map);
+		    printf("Loaded map:\n");
+		    dump_map(program_maps[i].map);
+		}
+		break;
 	    }
+	}
 
-	    continue;
+	const Map *layer_map = layer->map ? layer->map : layers->get(0)->map;
+
+	uint16_t x, y;
+	{
+	    PROFILE_ZONE("adc");
+	    x = calibration->apply(0, x_filter.filter(read_raw(2)));
+	    y = calibration->apply(1, y_filter.filter(read_raw(1)));
 	}
+	scheduler->moved(x, &last_x);
+	scheduler->moved(y, &last_y);
 
-	hid_buttons->begin_transaction();
+	uint8_t action;
+	{
+	    PROFILE_ZONE("map-lookup");
+	    action = layer_map->lookup(4095 - x, 4095 - y);
+	}
 
-	double x = adc->read_percentage(2);
-	double y = adc->read_percentage(1);
+	// UP, DOWN, LEFT and RIGHT are buttons #1 to #4 which are bits 0 to 3
+	if (action != SAME) directions = action & DIRECTIONS;
 
-	int x_region = (1 - x) * N_REGIONS;
-	int y_region = (1 - y) * N_REGIONS;
+	// Auto-fire needs the fast rate for as long as the button is held
+	if (pressed & layer->turbo) scheduler->activity();
 
-	uint8_t action = map[x_region + y_region * N_REGIONS];
+	uint32_t values = layer->apply(pressed | directions, LayerEngine::turbo_off(time_us_32()));
+	uint32_t mask = valid_buttons & ~DIRECTIONS;
 
-	if (action != SAME) {
-	    hid_buttons->set_button(1, (action & UP) != 0);
-	    hid_buttons->set_button(2, (action & DOWN) != 0);
-	    hid_buttons->set_button(3, (action & LEFT) != 0);
-	    hid_buttons->set_button(4, (action & RIGHT) != 0);
-	}
+#if DIRECTIONS_AS_HAT
+	hat->set(values & DIRECTIONS);
+#else
+	mask |= DIRECTIONS;
+#endif
 
-	for (int i = 0; i < n_buttons; i++) {
-	    if (buttons[i].gpio < 0) continue;
-	    hid_buttons->set_button(i+1, buttons[i].input->get());
+	{
+	    PROFILE_ZONE("set-buttons");
+	    hid_buttons->set_buttons(values, mask);
 	}
 
-	hid_buttons->end_transaction();
+	calibration->save_if_idle(scheduler->is_idle());
     }
 }
 
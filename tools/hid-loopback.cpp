@@ -0,0 +1,122 @@
+/* Host check of the HID report pipeline (pages -> collections -> controller
+ * -> transport) through LoopbackTransport, and of the zone profiler that
+ * times it.  Built by the host configuration (cmake -DPLATFORM=pi), it exits
+ * non-zero on any mismatch.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "gamepad.h"
+#include "console-command.h"
+#include "loopback-transport.h"
+#include "stdout-writer.h"
+#include "thumbstick-map.h"
+#include "zone-profiler.h"
+
+static int n_failed = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (! ok) n_failed++;
+}
+
+static bool report_is(LoopbackTransport *t, const uint8_t *expected, int len) {
+    return t->last_report_len == len && memcmp(t->last_report, expected, len) == 0;
+}
+
+static void single_collection() {
+    Gamepad *gp = new Gamepad();
+    HIDButtons *buttons = new HIDButtons(gp, 1, 12);
+    HIDHat *hat = new HIDHat(gp);
+    gp->add_hid_page(buttons);
+    gp->add_hid_page(hat);
+
+    LoopbackTransport *t = new LoopbackTransport();
+    gp->add_transport(t);
+    gp->initialize("loopback");
+
+    static const uint8_t header[] = { 0x05, 0x01, 0x09, 0x04, 0xa1, 0x01 };
+    check(t->descriptor_len > (int) sizeof(header) && memcmp(t->descriptor, header, sizeof(header)) == 0, "descriptor starts with a gamepad application collection");
+
+    buttons->set_button(3, true);
+    check(! t->poll(), "nothing is sent before a host connects");
+
+    t->connect();
+    check(t->poll(), "connecting requests a report");
+    // 12 buttons then a 4 bit hat (null state 8), no report id
+    static const uint8_t pressed[] = { 0x04, 0x80 };
+    check(report_is(t, pressed, sizeof(pressed)), "button 3 packs to bit 2 with a centered hat");
+
+    hat->set(UP);
+    check(t->poll(), "the hat change requests a report");
+    static const uint8_t up[] = { 0x04, 0x00 };
+    check(report_is(t, up, sizeof(up)), "hat up is 0 in the top nibble");
+    check(! t->poll(), "no report without a change");
+
+    t->disconnect();
+    check(! gp->is_connected(), "disconnected");
+}
+
+static void two_collections() {
+    Gamepad *gp = new Gamepad();
+    HIDButtons *p1 = new HIDButtons(gp, 1, 8);
+    gp->add_hid_page(p1);
+
+    HIDCollection *player2 = new HIDCollection(gp, 0x04);
+    HIDButtons *p2 = new HIDButtons(player2, 1, 8);
+    player2->add_hid_page(p2);
+    gp->add_collection(player2);
+
+    LoopbackTransport *usb = new LoopbackTransport();
+    LoopbackTransport *bt = new LoopbackTransport();
+    gp->add_transport(usb);
+    gp->add_transport(bt);
+    gp->initialize("loopback");
+
+    bt->connect();
+    while (bt->poll()) {}
+    int before = bt->n_reports;
+
+    p1->set_button(1, true);
+    p2->set_button(2, true);
+    check(bt->poll(), "player 1 report sent");
+    static const uint8_t report1[] = { 1, 0x01 };
+    check(report_is(bt, report1, sizeof(report1)), "player 1 report starts with report id 1");
+    check(bt->poll(), "player 2 still dirty so another report is requested");
+    static const uint8_t report2[] = { 2, 0x02 };
+    check(report_is(bt, report2, sizeof(report2)), "player 2 report starts with report id 2");
+    check(bt->n_reports == before + 2, "one report per changed collection");
+
+    usb->connect();
+    check(! bt->poll(), "the earlier transport takes over once connected");
+    int n = 0;
+    while (usb->poll()) n++;
+    check(n == 2, "the new transport gets the full state of both collections");
+
+    usb->disconnect();
+    check(gp->is_connected(), "still connected over the other transport");
+    n = 0;
+    while (bt->poll()) n++;
+    check(n == 2, "falling back resends the full state");
+}
+
+static void zones() {
+    ProfilerZone *send_report = NULL;
+
+    for (ProfilerZone *zone = ProfilerZone::get_all(); zone; zone = zone->get_next()) {
+	if (strcmp(zone->name, "send-report") == 0) send_report = zone;
+    }
+    check(send_report && send_report->n > 0, "the send-report zone was timed");
+    check(ConsoleCommand::process_cmd(new StdoutWriter(), "zones"), "the zones command is registered");
+}
+
+int main(int argc, char **argv) {
+    single_collection();
+    two_collections();
+#if ZONE_PROFILER
+    zones();
+#endif
+
+    printf("%s\n", n_failed ? "FAILED" : "all ok");
+    return n_failed ? 1 : 0;
+}
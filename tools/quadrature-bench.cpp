@@ -0,0 +1,50 @@
+/* Host benchmark of the quadrature decoder model (quadrature.h).  Built by
+ * the host configuration (cmake -DPLATFORM=pi -DCMAKE_BUILD_TYPE=Release).
+ *
+ * Spins a simulated encoder back and forth, checks that the decoded count
+ * matches the true position and reports the decode cost per sample.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "quadrature.h"
+
+// Gray code of the position, B leads A when counting up
+static void phases(int32_t position, int *a, int *b) {
+    static const int a_of[4] = { 0, 0, 1, 1 };
+    static const int b_of[4] = { 0, 1, 1, 0 };
+    *a = a_of[position & 3];
+    *b = b_of[position & 3];
+}
+
+int main(int argc, char **argv) {
+    const int n_samples = 100 * 1000 * 1000;
+    QuadratureModel model;
+    QuadratureAccumulator accumulator;
+    int32_t position = 0;
+    int64_t total = 0;
+    int a, b;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < n_samples; i++) {
+	// At most one step per sample, just like a state machine that samples faster than the edges
+	if ((i >> 20) & 1) position--;
+	else if (i % 3) position++;
+
+	phases(position, &a, &b);
+	model.sample(a, b);
+	if ((i & 1023) == 0) total += accumulator.delta(model.get_count());
+    }
+    total += accumulator.delta(model.get_count());
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    printf("%s: position %d count %d accumulated %lld, %.2f ns/sample\n",
+	model.get_count() == position && total == position ? "ok" : "MISMATCH",
+	position, model.get_count(), (long long) total, ns / n_samples);
+
+    return model.get_count() == position && total == position ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#!/usr/bin/env python3
+#
+# Converts the output of the "trace" console command to Chrome trace event
+# JSON which can be loaded into chrome://tracing or ui.perfetto.dev.
+#
+#   echo trace | nc pico 4567 | tools/trace-to-chrome.py > trace.json
+
+import json
+import sys
+
+BEGIN = { "transaction-begin": "transaction", "can-send-now-begin": "can-send-now" }
+END = { "transaction-end": "transaction", "can-send-now-end": "can-send-now" }
+
+def main():
+    events = []
+    for line in sys.stdin:
+        fields = line.split()
+        if len(fields) != 5 or fields[0] != "trace":
+            continue
+        _, core, us, name, arg = fields
+        event = { "pid": 0, "tid": int(core), "ts": int(us), "args": { "arg": int(arg) } }
+        if name in BEGIN:
+            event.update(name = BEGIN[name], ph = "B")
+        elif name in END:
+            event.update(name = END[name], ph = "E")
+        else:
+            event.update(name = name, ph = "i", s = "t")
+        events.append(event)
+
+    events.sort(key = lambda e: e["ts"])
+    json.dump({ "traceEvents": events, "displayTimeUnit": "ms" }, sys.stdout, indent = 1)
+
+if __name__ == "__main__":
+    main()
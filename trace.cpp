@@ -0,0 +1,98 @@
+#include <string.h>
+#include "pi.h"
+#include "pico-joystick.h"
+#include "trace.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+#define N_RINGS 2
+#else
+#include <atomic>
+#include <time.h>
+#define N_RINGS 1
+#endif
+
+static const char *event_names[N_TRACE_EVENTS] = {
+    "gpio-isr",
+    "thread-resume",
+    "transaction-begin",
+    "transaction-end",
+    "buttons-changed",
+    "request-can-send-now",
+    "can-send-now-begin",
+    "can-send-now-end",
+    "send-report",
+    "connect",
+    "disconnect",
+};
+
+static struct {
+    trace_record_t records[TRACE_RING_SIZE];
+#if PICO_ON_DEVICE
+    volatile uint32_t head;
+#else
+    std::atomic<uint32_t> head;
+#endif
+} rings[N_RINGS];
+
+void trace_event(trace_event_t event, uint16_t arg) {
+#if PICO_ON_DEVICE
+    /* Only this core writes this ring.  Interrupts are masked before reading
+     * the core number so the thread can't migrate, and head only moves past
+     * the slot once the record is complete so a dump from the other core
+     * never sees a half written one.
+     */
+    uint32_t saved = save_and_disable_interrupts();
+    uint core = get_core_num();
+    uint32_t slot = rings[core].head;
+    uint32_t us = time_us_32();
+#else
+    uint32_t core = 0;
+    uint32_t slot = rings[core].head.fetch_add(1);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint32_t us = now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+
+    trace_record_t *r = &rings[core].records[slot & (TRACE_RING_SIZE - 1)];
+    r->us = us;
+    r->event = event;
+    r->core = core;
+    r->arg = arg;
+
+#if PICO_ON_DEVICE
+    __dmb();
+    rings[core].head = slot + 1;
+    restore_interrupts(saved);
+#endif
+}
+
+class TraceCommand : public ConsoleCommand {
+public:
+    TraceCommand() : ConsoleCommand("trace", "[clear]") {
+    }
+
+    void process(Writer *w, int argc, char **argv) override {
+	bool clear = argc > 1 && strcmp(argv[1], "clear") == 0;
+
+	for (int core = 0; core < N_RINGS; core++) {
+	    if (clear) {
+		rings[core].head = 0;
+		continue;
+	    }
+
+	    uint32_t head = rings[core].head;
+	    uint32_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+	    for (uint32_t i = first; i < head; i++) {
+		trace_record_t r = rings[core].records[i & (TRACE_RING_SIZE - 1)];
+		if (r.event >= N_TRACE_EVENTS) continue;
+		w->printf("trace %d %lu %s %u\n", r.core, (unsigned long) r.us, event_names[r.event], r.arg);
+	    }
+	}
+    }
+};
+
+static TraceCommand trace_command;
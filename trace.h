@@ -0,0 +1,49 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+
+/* Event trace for timing problems.  Each core writes compact records into its
+ * own fixed size ring so ISRs and threads never contend across cores.  The
+ * "trace" console command dumps the rings as text which
+ * tools/trace-to-chrome.py converts to Chrome / Perfetto trace JSON.
+ * Build with TRACE_EVENTS=0 to compile every TRACE() out.
+ */
+
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 1
+#endif
+
+#define TRACE_RING_SIZE 512	// records per core, must be a power of 2
+
+typedef enum {
+    TRACE_GPIO_ISR,
+    TRACE_THREAD_RESUME,
+    TRACE_TRANSACTION_BEGIN,
+    TRACE_TRANSACTION_END,
+    TRACE_BUTTONS_CHANGED,
+    TRACE_REQUEST_CAN_SEND_NOW,
+    TRACE_CAN_SEND_NOW_BEGIN,
+    TRACE_CAN_SEND_NOW_END,
+    TRACE_SEND_REPORT,
+    TRACE_CONNECT,
+    TRACE_DISCONNECT,
+    N_TRACE_EVENTS
+} trace_event_t;
+
+typedef struct {
+    uint32_t us;
+    uint8_t event;
+    uint8_t core;
+    uint16_t arg;
+} trace_record_t;
+
+void trace_event(trace_event_t event, uint16_t arg = 0);
+
+#if TRACE_EVENTS
+#define TRACE(event, arg) trace_event(event, arg)
+#else
+#define TRACE(event, arg)
+#endif
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef __TUSB_CONFIG_H__
+#define __TUSB_CONFIG_H__
+
+/* TinyUSB configuration for UsbTransport: a device with a single HID
+ * interface.  USB stdio has to be disabled as it brings its own
+ * configuration and descriptors.
+ */
+
+#define CFG_TUSB_RHPORT0_MODE	OPT_MODE_DEVICE
+
+#ifndef CFG_TUSB_OS
+#define CFG_TUSB_OS		OPT_OS_PICO
+#endif
+
+#define CFG_TUD_ENABLED		1
+#define CFG_TUD_ENDPOINT0_SIZE	64
+
+#define CFG_TUD_HID		1
+#define CFG_TUD_CDC		0
+#define CFG_TUD_MSC		0
+#define CFG_TUD_MIDI		0
+#define CFG_TUD_VENDOR		0
+
+#define CFG_TUD_HID_EP_BUFSIZE	64
+
+#endif
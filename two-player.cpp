@@ -0,0 +1,90 @@
+#include "pi.h"
+#include "bluetooth/bluetooth.h"
+#include "hardware/gpio.h"
+#include "button-remap.h"
+#include "gamepad.h"
+#include "pico-joystick.h"
+
+#define N_PLAYERS 2
+
+static struct {
+    int gpio[N_PLAYERS];
+    const char *name;
+} buttons[] = {
+    { { 2, 12 }, "up" },
+    { { 3, 13 }, "down" },
+    { { 4, 14 }, "left" },
+    { { 5, 15 }, "right" },
+    { { 6, 16 }, "b1" },
+    { { 7, 17 }, "b2" },
+    { { 8, 18 }, "b3" },
+    { { 9, 19 }, "b4" },
+    { {10, 20 }, "start" },
+    { {11, 21 }, "coin" },
+};
+
+static const int n_buttons = sizeof(buttons) / sizeof(*buttons);
+
+class Panel : public Gamepad {
+public:
+    void on_connect() override {
+	Gamepad::on_connect();
+	connected = true;
+    }
+
+    void on_disconnect() override {
+	Gamepad::on_disconnect();
+	connected = false;
+    }
+
+    void wait_connected() {
+	while (! connected) ms_sleep(1000);
+    }
+
+private:
+    bool connected = false;
+};
+
+static void threads_main(int argc, char **argv) {
+    ButtonRemap *remaps[N_PLAYERS];
+
+    for (int player = 0; player < N_PLAYERS; player++) {
+	remaps[player] = new ButtonRemap();
+	for (int i = 0; i < n_buttons; i++) {
+	    GPInput *input = new GPInput(buttons[i].gpio[player]);
+	    input->set_pullup_up();
+	    remaps[player]->add(buttons[i].gpio[player], i);
+	}
+    }
+
+    pico_joystick_boot(NULL, -1, NULL, "two-player");
+
+    /* Player 1 is the controller's own collection, player 2 is a second
+     * gamepad collection sharing the same connection and scan loop.
+     */
+    Panel *panel = new Panel();
+    HIDCollection *players[N_PLAYERS] = { panel, new HIDCollection(panel, 0x04) };
+    HIDButtons *hid_buttons[N_PLAYERS];
+
+    for (int player = 0; player < N_PLAYERS; player++) {
+	hid_buttons[player] = new HIDButtons(players[player], 1, n_buttons);
+	players[player]->add_hid_page(hid_buttons[player]);
+	if (player > 0) panel->add_collection(players[player]);
+    }
+
+    panel->initialize("Pico Two Player");
+    bluetooth_start_gamepad("Pico Two Player");
+
+    while (1) {
+	panel->wait_connected();
+
+	uint32_t gpios = gpio_get_all();
+	for (int player = 0; player < N_PLAYERS; player++) {
+	    hid_buttons[player]->set_buttons(remaps[player]->remap(gpios), remaps[player]->buttons);
+	}
+    }
+}
+
+int main(int argc, char **argv) {
+   pi_init_with_threads(threads_main, argc, argv);
+}
@@ -0,0 +1,152 @@
+#include <string.h>
+#include "pi.h"
+#include "tusb.h"
+#include "pico/unique_id.h"
+#include "gamepad.h"
+#include "usb-transport.h"
+
+#define EPNUM_HID	0x81
+#define POLL_MS		1
+
+UsbTransport *UsbTransport::transport = NULL;
+
+UsbTransport::UsbTransport() : PiThread("usb") {
+    assert(transport == NULL);
+    transport = this;
+}
+
+void UsbTransport::start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) {
+    assert(max_report_len <= CFG_TUD_HID_EP_BUFSIZE);
+
+    this->controller = controller;
+    this->name = name;
+    this->descriptor = descriptor;
+
+    const uint8_t config[] = {
+	TUD_CONFIG_DESCRIPTOR(1, 1, 0, sizeof(configuration), TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+	TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_NONE, descriptor_len, EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, POLL_MS)
+    };
+    static_assert(sizeof(config) == sizeof(configuration), "USB configuration descriptor size");
+    memcpy(configuration, config, sizeof(configuration));
+
+    tusb_init();
+    PiThread::start(2);
+}
+
+void UsbTransport::request_send() {
+    requested = true;
+    resume();
+}
+
+void UsbTransport::send(const uint8_t *report, int len) {
+    // The report id (if any) is already the first byte of the report
+    tud_hid_report(0, report, len);
+}
+
+void UsbTransport::mounted(bool is_mounted) {
+    if (is_mounted) controller->transport_connected(this);
+    else controller->transport_disconnected(this);
+}
+
+void UsbTransport::main(void) {
+    while (1) {
+	tud_task();
+
+	if (requested && tud_hid_ready()) {
+	    requested = false;
+	    controller->transport_can_send_now(this);
+	}
+
+	pause();
+    }
+}
+
+/* Any USB event (including a finished report) wakes the thread to run tud_task() */
+
+extern "C" void tud_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr) {
+    UsbTransport *t = UsbTransport::get();
+
+    if (! t) return;
+    if (in_isr) t->resume_from_isr();
+    else t->resume();
+}
+
+extern "C" void tud_mount_cb(void) {
+    UsbTransport::get()->mounted(true);
+}
+
+extern "C" void tud_umount_cb(void) {
+    UsbTransport::get()->mounted(false);
+}
+
+extern "C" void tud_suspend_cb(bool remote_wakeup_en) {
+    UsbTransport::get()->mounted(false);
+}
+
+extern "C" void tud_resume_cb(void) {
+    UsbTransport::get()->mounted(true);
+}
+
+extern "C" const uint8_t *tud_hid_descriptor_report_cb(uint8_t instance) {
+    return UsbTransport::get()->get_descriptor();
+}
+
+extern "C" uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen) {
+    // Not supported, the stack stalls the request
+    return 0;
+}
+
+extern "C" void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize) {
+}
+
+extern "C" const uint8_t *tud_descriptor_device_cb(void) {
+    static const tusb_desc_device_t device = {
+	.bLength = sizeof(tusb_desc_device_t),
+	.bDescriptorType = TUSB_DESC_DEVICE,
+	.bcdUSB = 0x0200,
+	.bDeviceClass = 0x00,
+	.bDeviceSubClass = 0x00,
+	.bDeviceProtocol = 0x00,
+	.bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+	.idVendor = USB_VID,
+	.idProduct = USB_PID,
+	.bcdDevice = 0x0100,
+	.iManufacturer = 1,
+	.iProduct = 2,
+	.iSerialNumber = 3,
+	.bNumConfigurations = 1,
+    };
+
+    return (const uint8_t *) &device;
+}
+
+extern "C" const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    return UsbTransport::get()->get_configuration();
+}
+
+extern "C" const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    static uint16_t desc[32];
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    const char *str;
+
+    switch (index) {
+    case 0:
+	desc[1] = 0x0409;	// English
+	desc[0] = (TUSB_DESC_STRING << 8) | 4;
+	return desc;
+    case 1: str = "pico-joystick"; break;
+    case 2: str = UsbTransport::get()->get_product(); break;
+    case 3:
+	pico_get_unique_board_id_string(serial, sizeof(serial));
+	str = serial;
+	break;
+    default: return NULL;
+    }
+
+    int len = strlen(str);
+    if (len > 31) len = 31;
+    for (int i = 0; i < len; i++) desc[1 + i] = str[i];
+    desc[0] = (TUSB_DESC_STRING << 8) | (2 * len + 2);
+
+    return desc;
+}
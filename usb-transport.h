@@ -0,0 +1,43 @@
+#ifndef __USB_TRANSPORT_H__
+#define __USB_TRANSPORT_H__
+
+#include "hid-transport.h"
+#include "pi-threads.h"
+
+/* Reports over USB HID with a 1ms polling interval.  TinyUSB is only ever
+ * called from this transport's thread: request_send() wakes it up and it
+ * sends the next report whenever the HID endpoint is free.  There can only
+ * be one UsbTransport.
+ */
+
+#define USB_VID		0xcafe
+#define USB_PID		0x4010
+
+class UsbTransport : public HIDTransport, public PiThread {
+public:
+    UsbTransport();
+
+    void start(HIDController *controller, const char *name, uint8_t *descriptor, int descriptor_len, int max_report_len) override;
+    void request_send() override;
+    void send(const uint8_t *report, int len) override;
+
+    void main(void) override;
+
+    // TinyUSB callbacks
+    void mounted(bool is_mounted);
+    const uint8_t *get_descriptor() { return descriptor; }
+    const uint8_t *get_configuration() { return configuration; }
+    const char *get_product() { return name; }
+
+    static UsbTransport *get() { return transport; }
+
+private:
+    const char *name = NULL;
+    uint8_t *descriptor = NULL;
+    uint8_t configuration[9 + 9 + 9 + 7];
+    volatile bool requested = false;
+
+    static UsbTransport *transport;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include <string.h>
+#include "pi.h"
+#include "console-command.h"
+#include "zone-profiler.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#endif
+
+std::atomic<ProfilerZone *> ProfilerZone::all(NULL);
+
+ProfilerZone::ProfilerZone(const char *name) : name(name) {
+    next = all.load(std::memory_order_relaxed);
+    while (! all.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+#if PICO_ON_DEVICE
+uint32_t ZoneTimer::cycles_per_us() {
+    static uint32_t cycles = 0;
+    if (! cycles) cycles = clock_get_hz(clk_sys) / 1000000;
+    return cycles;
+}
+#endif
+
+class ZonesCommand : public ConsoleCommand {
+public:
+    ZonesCommand() : ConsoleCommand("zones", "[reset]") {
+    }
+
+    void process(Writer *w, int argc, char **argv) override {
+	bool reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+
+	if (! reset) w->printf("%-16s %10s %10s %10s %10s (%s)\n", "zone", "count", "min", "avg", "max", ZONE_PROFILER_UNIT);
+
+	for (ProfilerZone *zone = ProfilerZone::get_all(); zone; zone = zone->get_next()) {
+	    if (reset) zone->reset();
+	    else if (zone->n) {
+		w->printf("%-16s %10lu %10lu %10lu %10lu\n", zone->name, (unsigned long) zone->n, (unsigned long) zone->min,
+		    (unsigned long) (zone->total / zone->n), (unsigned long) zone->max);
+	    }
+	}
+    }
+};
+
+static ZonesCommand zones_command;
@@ -0,0 +1,127 @@
+#ifndef __ZONE_PROFILER_H__
+#define __ZONE_PROFILER_H__
+
+#include <atomic>
+#include <stdint.h>
+
+/* Scoped zone profiler.  PROFILE_ZONE("name") at the top of a block records
+ * the time until the end of the block into a named zone and the "zones"
+ * console command prints min/avg/max per zone.  On the pico the unit is CPU
+ * cycles, elsewhere it is nanoseconds from the monotonic clock.  Build with
+ * ZONE_PROFILER=0 to compile every zone out.
+ */
+
+#ifndef ZONE_PROFILER
+#define ZONE_PROFILER 1
+#endif
+
+#if PICO_ON_DEVICE
+#include "hardware/structs/systick.h"
+#include "hardware/timer.h"
+#define ZONE_PROFILER_UNIT "cycles"
+#else
+#include <time.h>
+#define ZONE_PROFILER_UNIT "ns"
+#endif
+
+class ProfilerZone {
+public:
+    ProfilerZone(const char *name);
+
+    void record(uint32_t t) {
+	n++;
+	total += t;
+	if (t < min) min = t;
+	if (t > max) max = t;
+    }
+
+    void reset() {
+	n = 0;
+	total = 0;
+	min = UINT32_MAX;
+	max = 0;
+    }
+
+    static ProfilerZone *get_all() { return all.load(std::memory_order_acquire); }
+    ProfilerZone *get_next() { return next; }
+
+    const char *name;
+    uint32_t n = 0;
+    uint64_t total = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+private:
+    ProfilerZone *next;
+
+    static std::atomic<ProfilerZone *> all;
+};
+
+class ZoneTimer {
+public:
+    ZoneTimer(ProfilerZone *zone) : zone(zone) {
+	start(&start_time);
+    }
+
+    ~ZoneTimer() {
+	zone->record(elapsed(&start_time));
+    }
+
+private:
+#if PICO_ON_DEVICE
+    struct Timestamp {
+	uint32_t us;
+	uint32_t systick;
+    };
+
+    /* SysTick counts down at the processor clock and reloads every scheduler
+     * tick so it gives cycles for short zones, anything longer (or a core
+     * without SysTick running) falls back to the microsecond timer.
+     */
+
+    static void start(Timestamp *t) {
+	t->systick = systick_hw->cvr;
+	t->us = time_us_32();
+    }
+
+    static uint32_t elapsed(Timestamp *t) {
+	uint32_t systick = systick_hw->cvr;
+	uint32_t us = time_us_32() - t->us;
+	uint32_t reload = systick_hw->rvr + 1;
+	bool systick_ok = (systick_hw->csr & 0x5) == 0x5;	// ENABLE and CLKSOURCE = processor
+
+	if (systick_ok && us < 100) return (t->systick + reload - systick) % reload;
+	return us * cycles_per_us();
+    }
+
+    static uint32_t cycles_per_us();
+#else
+    typedef struct timespec Timestamp;
+
+    static void start(Timestamp *t) {
+	clock_gettime(CLOCK_MONOTONIC, t);
+    }
+
+    static uint32_t elapsed(Timestamp *t) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - t->tv_sec) * 1000000000ull + now.tv_nsec - t->tv_nsec;
+    }
+#endif
+
+    ProfilerZone *zone;
+    Timestamp start_time;
+};
+
+#define ZONE_CONCAT2(a, b) a##b
+#define ZONE_CONCAT(a, b) ZONE_CONCAT2(a, b)
+
+#if ZONE_PROFILER
+#define PROFILE_ZONE(name) \
+    static ProfilerZone ZONE_CONCAT(zone_, __LINE__)(name); \
+    ZoneTimer ZONE_CONCAT(zone_timer_, __LINE__)(&ZONE_CONCAT(zone_, __LINE__))
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif